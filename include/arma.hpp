@@ -15,12 +15,18 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <alias.hpp>
 #include <bip.hpp>
 #include <estimation_result.hpp>
 #include <iomanip>
+#include <memory>
 #include <optional>
 #include <robust.hpp>
+#include <sketch.hpp>
+#include <stdexcept>
+#include <string>
+#include <utility>
 
 namespace robarma
 {
@@ -30,11 +36,23 @@ namespace robarma
      *
      * Holds the observed time series, model order (p, q), and basic statistics (mu, sigma).
      * Provides methods for extracting parameters and computing residuals.
+     *
+     * The series is read through y, a map over storage shared by all copies of the model, so
+     * copying a model, as every cost functor does, does not copy the series. A model built
+     * with view does not own its series at all and maps the caller's values, which must then
+     * outlive the model, its copies and its fits.
+     *
+     * Optional observation weights, set with set_weights, scale the contribution of each
+     * time point to the objective of every estimator. They are normalized to mean one, so
+     * unit weights reproduce the unweighted objectives.
      */
     class arma_model
     {
+    private:
+        std::shared_ptr<const Eigen::VectorXd> storage;
+
     public:
-        Eigen::VectorXd y;
+        Eigen::Map<const Eigen::VectorXd> y;
         int p;
         int q;
         int n;
@@ -42,13 +60,74 @@ namespace robarma
         int num_params;
         double sigma;
         double mu;
+        Eigen::VectorXd weights;
 
-        arma_model(Eigen::VectorXd y, int p, int q) : y{y}, p{p}, q{q}
+        arma_model(Eigen::VectorXd y, int p, int q)
+            : arma_model(std::make_shared<const Eigen::VectorXd>(std::move(y)), p, q)
+        {
+        }
+
+        // With a precomputed robust location and scale of y, e.g. from a series_panel
+        arma_model(Eigen::VectorXd y, int p, int q, double mu, double sigma)
+            : arma_model(std::make_shared<const Eigen::VectorXd>(std::move(y)), p, q, mu, sigma)
         {
-            n = y.size();
-            r = fmax(p, q);
-            mu = robarma::base::median(y);
-            sigma = robarma::base::scale<double>(y.array() - mu);
+        }
+
+        /**
+         * @brief Model over the caller's values, without copying them.
+         *
+         * @param y series, which must outlive the model, its copies and its fits
+         * @param p
+         * @param q
+         * @return arma_model
+         */
+        static arma_model view(Eigen::Map<const Eigen::VectorXd> y, int p, int q)
+        {
+            double mu = robarma::base::median(std::as_const(y));
+            double sigma = robarma::base::scale<double>(y.array() - mu);
+            return arma_model(nullptr, y, p, q, mu, sigma);
+        }
+
+        // With a precomputed robust location and scale of y, e.g. from a series_panel
+        static arma_model view(Eigen::Map<const Eigen::VectorXd> y, int p, int q, double mu, double sigma)
+        {
+            return arma_model(nullptr, y, p, q, mu, sigma);
+        }
+
+        // Whether the model maps the caller's values rather than its own storage
+        bool is_view() const
+        {
+            return !storage;
+        }
+
+        /**
+         * @brief Set observation weights, or clear them with an empty vector.
+         *
+         * @param w nonnegative weights of length n, not all zero
+         */
+        void set_weights(const Eigen::VectorXd &w)
+        {
+            if (w.size() == 0)
+            {
+                weights.resize(0);
+                return;
+            }
+            if (w.size() != n)
+                throw std::invalid_argument("Observation weights must have length n = " + std::to_string(n) + ", got " + std::to_string(w.size()) + ".");
+            if (!((w.array() >= 0.0).all() && w.sum() > 0.0))
+                throw std::invalid_argument("Observation weights must be nonnegative and not all zero.");
+            weights = w / w.mean();
+        }
+
+        bool weighted() const
+        {
+            return weights.size() != 0;
+        }
+
+        // Weight of time point t, one when unweighted
+        double weight(int t) const
+        {
+            return weighted() ? weights(t) : 1.0;
         }
 
         /**
@@ -68,51 +147,255 @@ namespace robarma
             return std::make_tuple(phi, theta, mu);
         }
 
+        /**
+         * @brief AR part of the residual recursion as a FIR filter
+         *
+         * Writes x_t = y_t - mu (1 - sum phi) - sum_j phi_j y_{t-j} for t >= r. The series does
+         * not depend on the parameters, so the filter runs lag by lag over tiles of the series,
+         * each lag an axpy on a cache-resident tile, instead of a reversed dot product per step.
+         *
+         * @param phi
+         * @param mu
+         * @param x output vector of length n, entries before r are left untouched
+         */
+        template <typename T>
+        void ar_filter(const Vec<T> &phi, T mu, Vec<T> &x) const
+        {
+            constexpr int tile = 256;
+            T level = mu * (T(1) - phi.sum());
+
+            for (int start = r; start < n; start += tile)
+            {
+                int length = std::min(tile, n - start);
+                auto out = x.segment(start, length);
+                out = y.segment(start, length).template cast<T>().array() - level;
+                for (int j = 0; j < p; j++)
+                    out -= y.segment(start - j - 1, length).template cast<T>() * phi(j);
+            }
+        }
+
+        /**
+         * @brief ARMA residuals
+         *
+         * The AR part is computed by ar_filter, the MA part as a compact IIR recursion over the
+         * residuals already computed.
+         *
+         * @param phi
+         * @param theta
+         * @param mu
+         * @return Vec<T> residuals, zero before r
+         */
         template <typename T>
         Vec<T> arma_residuals(Vec<T> phi, Vec<T> theta, T mu) const
         {
             Vec<T> e = Vec<T>::Zero(n);
+            ar_filter(phi, mu, e);
+
+            if (q > 0)
+            {
+                for (int i = r; i < n; i++)
+                {
+                    T ma = T(0);
+                    for (int j = 0; j < q; j++)
+                        ma += theta(j) * e(i - j - 1);
+                    e(i) -= ma;
+                }
+            }
+            return e;
+        }
+
+        /**
+         * @brief ARMA residuals and their sensitivities in a single pass
+         *
+         * Column j of J holds d e_t / d beta_j for beta = (phi, theta, mu), obtained
+         * by differentiating the residual recursion. Rows before r are zero.
+         *
+         * @param phi
+         * @param theta
+         * @param mu
+         * @param J output matrix of size n x (p + q + 1)
+         * @return Eigen::VectorXd residuals
+         */
+        Eigen::VectorXd arma_residuals(const Eigen::VectorXd &phi, const Eigen::VectorXd &theta, double mu, Eigen::MatrixXd &J) const
+        {
+            Eigen::VectorXd e = Eigen::VectorXd::Zero(n);
+            J = Eigen::MatrixXd::Zero(n, p + q + 1);
+            ar_filter<double>(phi, mu, e);
 
-            T ar;
-            T ma;
+            double c = 1.0 - phi.sum();
 
             for (int i = r; i < n; i++)
             {
-                ar = phi.dot(y.segment(i - p, p).reverse().template cast<T>());
-                ma = theta.dot(e.segment(i - q, q).reverse().template cast<T>());
-                e(i) = T(y(i)) - mu * (T(1) - phi.sum()) - ar - ma;
+                for (int j = 0; j < q; j++)
+                    e(i) -= theta(j) * e(i - j - 1);
+
+                for (int j = 0; j < p; j++)
+                    J(i, j) = mu - y(i - j - 1);
+                for (int j = 0; j < q; j++)
+                    J(i, p + j) = -e(i - j - 1);
+                J(i, p + q) = -c;
+
+                for (int k = 0; k < q; k++)
+                    J.row(i) -= theta(k) * J.row(i - k - 1);
             }
             return e;
         }
 
+        /**
+         * @brief BIP-ARMA residuals
+         *
+         * The observation part of the AR term is computed by ar_filter. The cleaned residuals
+         * sigma * eta(e_t / sigma) are computed once per residual into a lag buffer, from which
+         * the p- and q-windows of later steps are read.
+         *
+         * @param phi
+         * @param theta
+         * @param mu
+         * @param sigma
+         * @return Vec<T> residuals
+         */
         template <typename T>
         Vec<T> bip_arma_residuals(Vec<T> phi, Vec<T> theta, T mu, T sigma) const
         {
             Vec<T> e = Vec<T>::Zero(n);
+            Vec<T> eta = Vec<T>::Zero(n);
+            ar_filter(phi, mu, e);
 
-            T ar;
-            T rq;
-            T rp;
+            for (int i = r; i < n; i++)
+            {
+                T ei = e(i);
+                for (int j = 0; j < p; j++)
+                    ei -= phi(j) * (eta(i - j - 1) - e(i - j - 1));
+                for (int j = 0; j < q; j++)
+                    ei -= theta(j) * eta(i - j - 1);
 
-            Vec<T> _rq;
-            Vec<T> _rp;
+                e(i) = ei;
+                eta(i) = sigma * bip::eta(ei / sigma);
+            }
+            return e;
+        }
+
+        /**
+         * @brief BIP-ARMA residuals and their sensitivities in a single pass
+         *
+         * Differentiates the bounded innovation propagation recursion of bip_arma_residuals
+         * with the scale sigma held fixed. Column j of J holds d e_t / d beta_j for
+         * beta = (phi, theta, mu). Rows before r are zero.
+         *
+         * @param phi
+         * @param theta
+         * @param mu
+         * @param sigma
+         * @param J output matrix of size n x (p + q + 1)
+         * @return Eigen::VectorXd residuals
+         */
+        Eigen::VectorXd bip_arma_residuals(const Eigen::VectorXd &phi, const Eigen::VectorXd &theta, double mu, double sigma, Eigen::MatrixXd &J) const
+        {
+            Eigen::VectorXd e = Eigen::VectorXd::Zero(n);
+            Eigen::VectorXd eta = Eigen::VectorXd::Zero(n);
+            Eigen::VectorXd deta = Eigen::VectorXd::Zero(n);
+            J = Eigen::MatrixXd::Zero(n, p + q + 1);
+
+            double c = 1.0 - phi.sum();
 
             for (int i = r; i < n; i++)
             {
-                ar = phi.dot(y.segment(i - p, p).reverse().template cast<T>() - e.segment(i - p, p).reverse());
+                e(i) = y(i) - mu * c;
+                for (int j = 0; j < p; j++)
+                {
+                    e(i) -= phi(j) * (y(i - j - 1) - e(i - j - 1) + eta(i - j - 1));
+                    J(i, j) = mu - y(i - j - 1) + e(i - j - 1) - eta(i - j - 1);
+                }
+                for (int j = 0; j < q; j++)
+                {
+                    e(i) -= theta(j) * eta(i - j - 1);
+                    J(i, p + j) = -eta(i - j - 1);
+                }
+                J(i, p + q) = -c;
 
-                _rq = e.segment(i - q, q).reverse().array() / sigma;
-                _rp = e.segment(i - p, p).reverse().array() / sigma;
+                for (int k = 0; k < r; k++)
+                {
+                    double weight = 0.0;
+                    if (k < p)
+                        weight += phi(k) * (1.0 - deta(i - k - 1));
+                    if (k < q)
+                        weight -= theta(k) * deta(i - k - 1);
+                    J.row(i) += weight * J.row(i - k - 1);
+                }
 
-                rq = theta.dot((sigma * bip::eta(_rq).array()).matrix());
-                rp = phi.dot((sigma * bip::eta(_rp).array()).matrix());
-
-                e(i) = T(y(i)) - mu * (T(1) - phi.sum()) - ar - rq - rp;
+                eta(i) = sigma * bip::eta(e(i) / sigma);
+                deta(i) = bip::deta(e(i) / sigma);
             }
             return e;
         }
+
+        /**
+         * @brief Generalized least squares location for given ARMA coefficients
+         *
+         * The residuals are affine in mu, e(mu) = e(0) + mu * d, so the location minimizing
+         * the (weighted) residual sum of squares is -<e(0), d>_w / <d, d>_w. Falls back to the
+         * sample median when d vanishes (unit root).
+         *
+         * @param phi
+         * @param theta
+         * @return double
+         */
+        double gls_location(const Eigen::VectorXd &phi, const Eigen::VectorXd &theta) const
+        {
+            Eigen::VectorXd e0 = arma_residuals<double>(phi, theta, 0.0);
+            Eigen::VectorXd d = arma_residuals<double>(phi, theta, 1.0) - e0;
+            if (weighted())
+                e0.array() *= weights.array();
+            double dd = weighted() ? d.dot(weights.cwiseProduct(d)) : d.squaredNorm();
+            return (dd > 0.0) ? -e0.dot(d) / dd : mu;
+        }
+
+    private:
+        arma_model(std::shared_ptr<const Eigen::VectorXd> storage, int p, int q)
+            : arma_model(storage, Eigen::Map<const Eigen::VectorXd>(storage->data(), storage->size()), p, q, 0.0, 0.0)
+        {
+            mu = robarma::base::median(std::as_const(y));
+            sigma = robarma::base::scale<double>(y.array() - mu);
+        }
+
+        arma_model(std::shared_ptr<const Eigen::VectorXd> storage, int p, int q, double mu, double sigma)
+            : arma_model(storage, Eigen::Map<const Eigen::VectorXd>(storage->data(), storage->size()), p, q, mu, sigma)
+        {
+        }
+
+        arma_model(std::shared_ptr<const Eigen::VectorXd> storage, Eigen::Map<const Eigen::VectorXd> y, int p, int q, double mu, double sigma)
+            : storage{std::move(storage)}, y{y}, p{p}, q{q}, sigma{sigma}, mu{mu}
+        {
+            n = y.size();
+            r = fmax(p, q);
+        }
     };
 
+    /**
+     * @brief Exponential forgetting weights lambda^(n - 1 - t), t = 0, ..., n - 1.
+     *
+     * The most recent observation has weight one and every step back discounts by lambda,
+     * for an effective window of about 1 / (1 - lambda) observations.
+     *
+     * @param n series length
+     * @param lambda forgetting factor in (0, 1]
+     * @return Eigen::VectorXd
+     */
+    inline Eigen::VectorXd exponential_weights(int n, double lambda)
+    {
+        if (!(lambda > 0.0 && lambda <= 1.0))
+            throw std::invalid_argument("Forgetting factor must lie in (0, 1], got " + std::to_string(lambda) + ".");
+
+        Eigen::VectorXd w(n);
+        double value = 1.0;
+        for (int t = n - 1; t >= 0; t--)
+        {
+            w(t) = value;
+            value *= lambda;
+        }
+        return w;
+    }
+
     /**
      * @brief Stores ARMA model parameters (phi, theta, mu).
      *
@@ -138,6 +421,26 @@ namespace robarma
               mu(*_mu) {}
     };
 
+    /**
+     * @brief Contamination pre-screen of a series, as recorded by estimators::auto_fit.
+     *
+     *  - robust_scale: MADN of the Hannan-Rissanen residuals
+     *  - classical_scale: standard deviation of the same residuals
+     *  - scale_ratio: classical_scale / robust_scale, close to one for Gaussian innovations
+     *  - flagged_fraction: fraction of residuals beyond the cutoff in robust scale units
+     *  - contaminated: decision of the screen
+     *  - selected: estimator the fit was dispatched to
+     */
+    struct contamination_screen
+    {
+        double robust_scale;
+        double classical_scale;
+        double scale_ratio;
+        double flagged_fraction;
+        bool contaminated;
+        estimation_method selected;
+    };
+
     /**
      * @brief Stores the result of ARMA parameter estimation.
      *
@@ -147,6 +450,10 @@ namespace robarma
      *  - result: estimation result (final)
      *  - initial_params: (optional) initial parameters used for optimization
      *  - initial_result: (optional) initial estimation result
+     *  - residuals: (optional) one-step residuals at the final parameters, from the recursion of
+     *    the method (BIP for BIP-S and BIP-MM), cached by the solver with keep_residuals
+     *  - residual_quantiles: (optional) quantile sketch of the residuals, filled in the same pass
+     *  - screen: (optional) contamination pre-screen, set by estimators::auto_fit
      *
      * Used to track both the initial and final state of an estimation process.
      */
@@ -158,6 +465,9 @@ namespace robarma
         estimation_result result;
         std::optional<arma_params> initial_params;
         std::optional<estimation_result> initial_result;
+        std::optional<Eigen::VectorXd> residuals;
+        std::optional<sketch::kll> residual_quantiles;
+        std::optional<contamination_screen> screen;
 
         arma_fit(const arma_model &model, const arma_params &params, estimation_result result,
                  std::optional<arma_params> initial_params = std::nullopt,
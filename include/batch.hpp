@@ -0,0 +1,173 @@
+/**
+ * @file batch.hpp
+ * @brief Fitting the series of a panel in parallel.
+ *
+ * Series are handed out to worker threads one at a time from a shared counter, so that
+ * long and short series balance across the workers. Each worker builds the model of a
+ * series from the panel, with its precomputed location and scale, fits it and passes the
+ * fit to a sink before the model goes out of scope. A fit_columns sink stores the results
+ * straight into preallocated columns.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <arma.hpp>
+#include <atomic>
+#include <chrono>
+#include <columns.hpp>
+#include <estimators.hpp>
+#include <exception>
+#include <mutex>
+#include <options.hpp>
+#include <panel.hpp>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace robarma::batch
+{
+    /**
+     * @brief Number of worker threads for a requested count, all hardware threads for threads <= 0.
+     *
+     * @param threads
+     * @param tasks never more workers than tasks
+     * @return int
+     */
+    inline int workers(int threads, int tasks)
+    {
+        if (threads <= 0)
+            threads = std::max(1, int(std::thread::hardware_concurrency()));
+        return std::max(1, std::min(threads, tasks));
+    }
+
+    /**
+     * @brief Call f(i) for i = 0, ..., count - 1 on a pool of worker threads.
+     *
+     * The first exception thrown by f stops the hand-out of further indices and is
+     * rethrown once all workers have finished.
+     *
+     * @param count
+     * @param threads number of workers, all hardware threads for threads <= 0
+     * @param f
+     */
+    template <typename F>
+    void parallel_for(int count, int threads, F &&f)
+    {
+        int n_workers = workers(threads, count);
+        if (n_workers == 1)
+        {
+            for (int i = 0; i < count; i++)
+                f(i);
+            return;
+        }
+
+        std::atomic<int> next{0};
+        std::exception_ptr error;
+        std::mutex error_mutex;
+
+        auto work = [&]()
+        {
+            for (int i = next++; i < count; i = next++)
+            {
+                try
+                {
+                    f(i);
+                }
+                catch (...)
+                {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error)
+                        error = std::current_exception();
+                    next = count;
+                }
+            }
+        };
+
+        std::vector<std::thread> pool;
+        pool.reserve(n_workers - 1);
+        for (int w = 1; w < n_workers; w++)
+            pool.emplace_back(work);
+        work();
+        for (std::thread &thread : pool)
+            thread.join();
+
+        if (error)
+            std::rethrow_exception(error);
+    }
+
+    /**
+     * @brief Fit an ARMA(p, q) model to every series of a panel.
+     *
+     * The sink is called as sink(i, fit, seconds), or sink(i, fit) when it takes two
+     * arguments, from the worker threads, concurrently for different series, with the
+     * wall-clock time of the fit. It must not keep the fit, which refers to a model that
+     * lives only during the call. The fits do not cache their residual vectors, see
+     * estimation_options::keep_residuals.
+     *
+     * @param panel
+     * @param p
+     * @param q
+     * @param method
+     * @param sink callable void(int i, const arma_fit &fit, double seconds), e.g. fit_columns
+     * @param options
+     * @param threads number of workers, all hardware threads for threads <= 0
+     */
+    template <typename Sink>
+    void fit(const series_panel &panel, int p, int q, estimation_method method, Sink &&sink, const estimation_options &options = {}, int threads = 0)
+    {
+        estimation_options batch_options = options;
+        batch_options.keep_residuals = false;
+
+        parallel_for(panel.size(), threads, [&](int i)
+                     {
+            auto start = std::chrono::steady_clock::now();
+            arma_model model = panel.model(i, p, q);
+            arma_fit fit = robarma::estimators::fit(model, method, batch_options);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+            if constexpr (std::is_invocable_v<Sink &, int, const arma_fit &, double>)
+                sink(i, fit, elapsed.count());
+            else
+                sink(i, fit); });
+    }
+
+    /**
+     * @brief ARMA(p, q) fits to every series of a panel, in columns.
+     *
+     * @param panel
+     * @param p
+     * @param q
+     * @param method
+     * @param options
+     * @param threads number of workers, all hardware threads for threads <= 0
+     * @return fit_columns with row i fitted to series i
+     */
+    inline fit_columns fit_to_columns(const series_panel &panel, int p, int q, estimation_method method, const estimation_options &options = {}, int threads = 0)
+    {
+        fit_columns columns(panel.size(), p, q);
+        fit(panel, p, q, method, columns, options, threads);
+        return columns;
+    }
+
+    /**
+     * @brief Parameters of an ARMA(p, q) fit to every series of a panel.
+     *
+     * @param panel
+     * @param p
+     * @param q
+     * @param method
+     * @param options
+     * @param threads number of workers, all hardware threads for threads <= 0
+     * @return std::vector<arma_params> with entry i fitted to series i
+     */
+    inline std::vector<arma_params> fit(const series_panel &panel, int p, int q, estimation_method method, const estimation_options &options = {}, int threads = 0)
+    {
+        std::vector<arma_params> params(panel.size());
+        fit(panel, p, q, method, [&params](int i, const arma_fit &fit)
+            { params[i] = fit.params; }, options, threads);
+        return params;
+    }
+} // namespace robarma::batch
+
+// end of file
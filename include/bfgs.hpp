@@ -0,0 +1,391 @@
+/**
+ * @file bfgs.hpp
+ * @brief Dense BFGS minimizer with strong Wolfe line search for small parameter spaces.
+ *
+ * ARMA problems have only p + q + 1 parameters, so the optimizer keeps its whole state
+ * (iterate, gradient, inverse Hessian approximation) in fixed-size stack buffers and
+ * performs no heap allocations. Gradients of the cost functors are obtained with
+ * ceres::Jet in chunks of four, as ceres::DynamicAutoDiffCostFunction does, but without
+ * building a ceres::Problem.
+ *
+ * See Nocedal & Wright, Numerical Optimization, Alg. 3.5, 3.6 and 6.1.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <ceres/ceres.h>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace robarma::bfgs
+{
+    // Largest supported number of parameters, p + q + 1
+    constexpr int max_parameters = 16;
+
+    using vector = std::array<double, max_parameters>;
+    using matrix = std::array<double, max_parameters * max_parameters>;
+
+    /**
+     * @brief Stopping rules, with the same defaults as ceres::Solver::Options.
+     */
+    struct options
+    {
+        int max_iterations = 50;
+        int max_line_search_evaluations = 20;
+        double function_tolerance = 1e-6;
+        double gradient_tolerance = 1e-10;
+        double parameter_tolerance = 1e-8;
+        double sufficient_decrease = 1e-4;
+        double curvature = 0.9;
+    };
+
+    struct summary
+    {
+        bool convergence = false;
+        int iterations = 0;
+        int evaluations = 0;
+        double cost = 0.0;
+        const char *message = nullptr;
+
+        std::string report() const
+        {
+            std::ostringstream ss;
+            ss << "BFGS: " << message << ", iterations " << iterations << ", evaluations " << evaluations << ", cost " << cost;
+            return ss.str();
+        }
+    };
+
+    namespace detail
+    {
+        inline double dot(const vector &a, const vector &b, int k)
+        {
+            double s = 0.0;
+            for (int i = 0; i < k; i++)
+                s += a[i] * b[i];
+            return s;
+        }
+
+        // Trial step inside the bracket [lo, hi], where lo has the lower cost. Uses the cubic
+        // interpolating both ends, falling back to the quadratic through f_lo, g_lo and f_hi,
+        // and is safeguarded to lie between 1% and 90% of the way from lo to hi.
+        inline double interpolate(double lo, double f_lo, double g_lo, double hi, double f_hi, double g_hi)
+        {
+            double w = hi - lo;
+            double t = lo + 0.1 * w;
+
+            if (std::isfinite(f_hi))
+            {
+                double d1 = g_lo + g_hi - 3.0 * (f_lo - f_hi) / (lo - hi);
+                double disc = d1 * d1 - g_lo * g_hi;
+                double cubic = std::numeric_limits<double>::quiet_NaN();
+                if (disc >= 0.0)
+                {
+                    double d2 = std::copysign(std::sqrt(disc), hi - lo);
+                    cubic = hi - w * (g_hi + d2 - d1) / (g_hi - g_lo + 2.0 * d2);
+                }
+
+                double c = (f_hi - f_lo - g_lo * w) / (w * w);
+                double quadratic = lo - g_lo / (2.0 * c);
+
+                if (std::isfinite(cubic) && (cubic - lo) / w > 0.0 && (cubic - lo) / w < 1.0)
+                    t = cubic;
+                else if (c > 0.0 && std::isfinite(quadratic))
+                    t = quadratic;
+            }
+
+            double fraction = std::fmin(std::fmax((t - lo) / w, 0.01), 0.9);
+            return lo + fraction * w;
+        }
+
+        // Value and gradient of 0.5 * r^2 for a functor over parameter blocks starting at the
+        // given offsets of x, differentiating the leading k of its size entries
+        template <typename Functor, std::size_t Blocks>
+        double value_and_gradient(const Functor &functor, const std::array<int, Blocks> &offsets, int size, const double *x, double *gradient, int k)
+        {
+            using Jet = ceres::Jet<double, 4>;
+
+            std::array<Jet, max_parameters> jets;
+            std::array<const Jet *, Blocks> blocks;
+            for (std::size_t b = 0; b < Blocks; b++)
+                blocks[b] = jets.data() + offsets[b];
+
+            double value = 0.0;
+            for (int start = 0; start < std::max(k, 1); start += 4)
+            {
+                for (int i = 0; i < size; i++)
+                {
+                    jets[i] = (i >= start && i < std::min(k, start + 4)) ? Jet(x[i], i - start) : Jet(x[i]);
+                }
+
+                Jet r;
+                if (!functor(blocks.data(), &r) || !std::isfinite(r.a))
+                    return std::numeric_limits<double>::infinity();
+
+                value = 0.5 * r.a * r.a;
+                for (int i = start; i < std::min(k, start + 4); i++)
+                {
+                    gradient[i] = r.a * r.v[i - start];
+                }
+            }
+            return value;
+        }
+    } // namespace detail
+
+    /**
+     * @brief Value and gradient of an ARMA cost functor.
+     *
+     * Evaluates functor(phi, theta, mu) for the packed parameter vector x = (phi, theta, mu)
+     * with ceres::Jet<double, 4>, returning 0.5 * r^2 to match the Ceres objective. Only the
+     * leading k entries of x are differentiated, the rest are held constant.
+     *
+     * @return value, or infinity if the functor fails or returns a non-finite value
+     */
+    template <typename Functor>
+    double value_and_gradient(const Functor &functor, int p, int q, const double *x, double *gradient, int k)
+    {
+        return detail::value_and_gradient(functor, std::array<int, 3>{0, p, p + q}, p + q + 1, x, gradient, k);
+    }
+
+    /**
+     * @brief Value and gradient of a cost functor over a single block of k parameters.
+     */
+    template <typename Functor>
+    double value_and_gradient(const Functor &functor, const double *x, double *gradient, int k)
+    {
+        return detail::value_and_gradient(functor, std::array<int, 1>{0}, k, x, gradient, k);
+    }
+
+    /**
+     * @brief Minimize f with dense BFGS and a strong Wolfe line search.
+     *
+     * @param f callable double(const double *x, double *gradient) returning the value
+     * @param x initial point, overwritten with the solution
+     * @param k number of parameters, at most max_parameters
+     * @param opts stopping rules
+     * @return summary
+     */
+    template <typename F>
+    summary minimize(F &&f, double *x, int k, const options &opts = {})
+    {
+        summary result;
+
+        vector xk{}, gk{}, d{}, xt{}, gt{}, s{}, y{};
+        matrix H{};
+
+        for (int i = 0; i < k; i++)
+            xk[i] = x[i];
+
+        double fk = f(xk.data(), gk.data());
+        result.evaluations++;
+
+        if (!std::isfinite(fk))
+        {
+            result.cost = fk;
+            result.message = "non-finite initial cost";
+            return result;
+        }
+
+        for (int i = 0; i < k; i++)
+            H[i * max_parameters + i] = 1.0;
+
+        auto gradient_norm = [&](const vector &g)
+        {
+            double m = 0.0;
+            for (int i = 0; i < k; i++)
+                m = std::fmax(m, std::abs(g[i]));
+            return m;
+        };
+
+        while (result.iterations < opts.max_iterations)
+        {
+            if (gradient_norm(gk) <= opts.gradient_tolerance)
+            {
+                result.convergence = true;
+                result.message = "gradient tolerance reached";
+                break;
+            }
+
+            // Search direction d = -H g, reset to steepest descent if not a descent direction
+            for (int i = 0; i < k; i++)
+            {
+                d[i] = 0.0;
+                for (int j = 0; j < k; j++)
+                    d[i] -= H[i * max_parameters + j] * gk[j];
+            }
+            double slope0 = detail::dot(gk, d, k);
+            bool steepest = (result.iterations == 0);
+            if (!(slope0 < 0.0))
+            {
+                for (int i = 0; i < k; i++)
+                {
+                    for (int j = 0; j < k; j++)
+                        H[i * max_parameters + j] = (i == j) ? 1.0 : 0.0;
+                    d[i] = -gk[i];
+                }
+                slope0 = -detail::dot(gk, gk, k);
+                steepest = true;
+            }
+
+            // Strong Wolfe line search
+            auto phi = [&](double alpha, double &slope)
+            {
+                for (int i = 0; i < k; i++)
+                    xt[i] = xk[i] + alpha * d[i];
+                double value = f(xt.data(), gt.data());
+                result.evaluations++;
+                slope = detail::dot(gt, d, k);
+                return value;
+            };
+
+            // Steepest descent steps are unscaled, so start them at unit length
+            double alpha = steepest ? std::fmin(1.0, 1.0 / std::sqrt(detail::dot(d, d, k))) : 1.0;
+            double alpha_prev = 0.0;
+            double f_prev = fk;
+            double slope_prev = slope0;
+            double ft = 0.0;
+            double slope = 0.0;
+            bool found = false;
+
+            double lo = 0.0, f_lo = fk, slope_lo = slope0;
+            double hi = 0.0, f_hi = 0.0, slope_hi = 0.0;
+            bool bracketed = false;
+
+            for (int ls = 0; ls < opts.max_line_search_evaluations; ls++)
+            {
+                if (!bracketed)
+                {
+                    ft = phi(alpha, slope);
+                    if (!std::isfinite(ft) || ft > fk + opts.sufficient_decrease * alpha * slope0 || (ls > 0 && ft >= f_prev))
+                    {
+                        lo = alpha_prev, f_lo = f_prev, slope_lo = slope_prev;
+                        hi = alpha, f_hi = ft, slope_hi = slope;
+                        bracketed = true;
+                        continue;
+                    }
+                    if (std::abs(slope) <= -opts.curvature * slope0)
+                    {
+                        found = true;
+                        break;
+                    }
+                    if (slope >= 0.0)
+                    {
+                        lo = alpha, f_lo = ft, slope_lo = slope;
+                        hi = alpha_prev, f_hi = f_prev, slope_hi = slope_prev;
+                        bracketed = true;
+                        continue;
+                    }
+                    alpha_prev = alpha, f_prev = ft, slope_prev = slope;
+                    alpha *= 2.0;
+                    continue;
+                }
+
+                // Zoom between lo and hi
+                double trial = detail::interpolate(lo, f_lo, slope_lo, hi, f_hi, slope_hi);
+                ft = phi(trial, slope);
+                if (!std::isfinite(ft) || ft > fk + opts.sufficient_decrease * trial * slope0 || ft >= f_lo)
+                {
+                    hi = trial, f_hi = ft, slope_hi = slope;
+                }
+                else
+                {
+                    if (std::abs(slope) <= -opts.curvature * slope0)
+                    {
+                        alpha = trial;
+                        found = true;
+                        break;
+                    }
+                    if (slope * (hi - lo) >= 0.0)
+                    {
+                        hi = lo, f_hi = f_lo, slope_hi = slope_lo;
+                    }
+                    lo = trial, f_lo = ft, slope_lo = slope;
+                }
+                if (std::abs(hi - lo) * std::sqrt(detail::dot(d, d, k)) < opts.parameter_tolerance)
+                    break;
+            }
+
+            if (!found)
+            {
+                // Accept the best sufficient-decrease point of the bracket if there is one
+                if (bracketed && lo > 0.0 && f_lo < fk)
+                {
+                    alpha = lo;
+                    ft = phi(alpha, slope);
+                }
+                else
+                {
+                    result.message = "line search failed";
+                    break;
+                }
+            }
+
+            result.iterations++;
+
+            double step_norm = 0.0;
+            double x_norm = 0.0;
+            for (int i = 0; i < k; i++)
+            {
+                s[i] = xt[i] - xk[i];
+                y[i] = gt[i] - gk[i];
+                step_norm += s[i] * s[i];
+                x_norm += xk[i] * xk[i];
+            }
+
+            double decrease = fk - ft;
+            xk = xt;
+            gk = gt;
+            fk = ft;
+
+            if (decrease <= opts.function_tolerance * std::abs(fk + decrease))
+            {
+                result.convergence = true;
+                result.message = "function tolerance reached";
+                break;
+            }
+            if (std::sqrt(step_norm) <= opts.parameter_tolerance * (std::sqrt(x_norm) + opts.parameter_tolerance))
+            {
+                result.convergence = true;
+                result.message = "parameter tolerance reached";
+                break;
+            }
+
+            // Inverse Hessian update H <- (I - rho s y') H (I - rho y s') + rho s s'
+            double sy = detail::dot(s, y, k);
+            if (sy > std::numeric_limits<double>::epsilon() * std::sqrt(detail::dot(s, s, k) * detail::dot(y, y, k)))
+            {
+                if (result.iterations == 1)
+                {
+                    double scale = sy / detail::dot(y, y, k);
+                    for (int i = 0; i < k; i++)
+                        for (int j = 0; j < k; j++)
+                            H[i * max_parameters + j] = (i == j) ? scale : 0.0;
+                }
+
+                double rho = 1.0 / sy;
+                vector Hy{};
+                for (int i = 0; i < k; i++)
+                    for (int j = 0; j < k; j++)
+                        Hy[i] += H[i * max_parameters + j] * y[j];
+                double yHy = detail::dot(y, Hy, k);
+
+                for (int i = 0; i < k; i++)
+                    for (int j = 0; j < k; j++)
+                        H[i * max_parameters + j] += (1.0 + rho * yHy) * rho * s[i] * s[j] - rho * (Hy[i] * s[j] + s[i] * Hy[j]);
+            }
+        }
+
+        if (!result.message)
+            result.message = "maximum number of iterations reached";
+
+        for (int i = 0; i < k; i++)
+            x[i] = xk[i];
+        result.cost = fk;
+        return result;
+    }
+} // namespace robarma::bfgs
+
+// end of file
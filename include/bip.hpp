@@ -3,6 +3,8 @@
 #include <Eigen/Dense>
 #include <alias.hpp>
 #include <ceres/ceres.h>
+#include <ratio>
+#include <rho.hpp>
 
 /**
  * @brief Rho functions used in MM-, BIP-MM and S-estimators as defined in \cite Muler
@@ -10,44 +12,35 @@
  */
 namespace robarma::bip
 {
+    // rho2 of the MM-step, whose psi eta also cleans the residuals of the BIP recursion
+    using rho2_family = rho::optimal<>;
+
+    // rho1 of the S-scale
+    using rho1_family = rho::optimal<std::ratio<405, 1000>>;
+
     template <typename T>
     T eta(const T x)
     {
-        if (ceres::abs(x) <= T(2))
-        {
-            return x;
-        }
-        else if (T(2) < ceres::abs(x) && ceres::abs(x) <= T(3))
-        {
-            return T(0.016) * ceres::pow(x, 7) - T(0.312) * ceres::pow(x, 5) + T(1.728) * pow(x, 3) - T(1.944) * x;
-        }
-        else
-        {
-            return T(0);
-        }
+        return rho2_family::psi(x);
+    }
+
+    // Derivative of eta, which is also the second derivative of rho2
+    template <typename T>
+    T deta(const T x)
+    {
+        return rho2_family::dpsi(x);
     }
 
     template <typename T>
     T rho2(const T x)
     {
-        if (ceres::abs(x) <= T(2))
-        {
-            return T(0.5) * ceres::pow(x, 2);
-        }
-        else if (T(2) < ceres::abs(x) && ceres::abs(x) <= T(3))
-        {
-            return T(0.002) * ceres::pow(x, 8) - T(0.052) * ceres::pow(x, 6) + T(0.432) * ceres::pow(x, 4) - T(0.972) * ceres::pow(x, 2) + T(1.792);
-        }
-        else
-        {
-            return T(3.25);
-        }
+        return rho2_family::rho(x);
     }
 
     template <typename T>
     T rho1(const T x)
     {
-        return rho2(x / T(0.405));
+        return rho1_family::rho(x);
     }
 
     template <typename T>
@@ -67,5 +60,11 @@ namespace robarma::bip
     {
         return x.unaryExpr(static_cast<T (*)(const T)>(&eta));
     }
+
+    template <typename T>
+    Vec<T> deta(const Vec<T> x)
+    {
+        return x.unaryExpr(static_cast<T (*)(const T)>(&deta));
+    }
 } // namespace robarma::bip
 // end of file
\ No newline at end of file
@@ -4,6 +4,8 @@
 #include <alias.hpp>
 #include <arma.hpp>
 #include <bip.hpp>
+#include <profile.hpp>
+#include <rho.hpp>
 #include <ceres/ceres.h>
 #include <hr.hpp>
 #include <robust.hpp>
@@ -12,6 +14,12 @@
 
 namespace robarma::estimators
 {
+    /**
+     * @brief M-scale of the BIP-ARMA residuals.
+     *
+     * @tparam Rho bounded rho family of the M-scale, see rho.hpp
+     */
+    template <typename Rho = robarma::bip::rho1_family>
     struct bip_s_functor
     {
     private:
@@ -31,6 +39,19 @@ namespace robarma::estimators
             return model.sigma / (T(1) + ceres::pow(kappa, 2) * causal(phi, theta).array().square().sum());
         }
 
+        // Robust location step used when mu is concentrated out
+        template <typename T>
+        T location(const Vec<T> &phi, const Vec<T> &theta) const
+        {
+            return profile::robust_location(model, phi, theta);
+        }
+
+        // One-step residuals of a fit, from the BIP recursion of the objective
+        Eigen::VectorXd residuals(const arma_params &params) const
+        {
+            return model.bip_arma_residuals(params.phi, params.theta, params.mu, bip_sigma(params.phi, params.theta));
+        }
+
         template <typename T>
         bool operator()(T const *const *parameters, T *residuals) const
         {
@@ -39,25 +60,25 @@ namespace robarma::estimators
             // delta is b = a/2, and a = max rho1
             T sigma = bip_sigma(phi, theta);
 
-            T delta = T(3.25 / 2);
-            std::function<Vec<T>(Vec<T>)> func = static_cast<Vec<T> (*)(const Vec<T>)>(&robarma::bip::rho1);
-            T est = robarma::base::scale(model.bip_arma_residuals(phi, theta, mu, sigma), delta, func);
+            T est = robarma::rho::scale<Rho>(model.bip_arma_residuals(phi, theta, mu, sigma), model.weights);
             residuals[0] = est;
             return true;
         };
     };
 
-    inline arma_fit bip_s(const arma_model &model)
+    template <typename Rho = robarma::bip::rho1_family>
+    inline arma_fit bip_s(const arma_model &model, const estimation_options &options = {})
     {
         // Calculate the initial S-estimator for ARMA model
         arma_fit initial = robarma::initial::hannan_rissanen(model);
 
-        auto *cost_function = new ceres::DynamicAutoDiffCostFunction<bip_s_functor, 4>(new bip_s_functor(model));
+        auto make_cost = [](const arma_model &m)
+        { return bip_s_functor<Rho>(m); };
 
-        ceres::Solver::Options options;
-        options.minimizer_type = ceres::LINE_SEARCH;
+        ceres::Solver::Options ceres_options;
+        ceres_options.minimizer_type = ceres::LINE_SEARCH;
 
-        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::bs, cost_function, options);
+        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::bs, make_cost, ceres_options, options);
         return fit;
     }
 } // namespace robarma::estimators
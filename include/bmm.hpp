@@ -4,10 +4,17 @@
 #include <alias.hpp>
 #include <arma.hpp>
 #include <bip.hpp>
+#include <profile.hpp>
 #include <solver.hpp>
 
 namespace robarma::bmm
 {
+    /**
+     * @brief BIP-MM objective for a fixed scale sigma.
+     *
+     * @tparam Rho rho family of the objective, see rho.hpp
+     */
+    template <typename Rho = robarma::bip::rho2_family>
     struct cost
     {
     private:
@@ -20,27 +27,61 @@ namespace robarma::bmm
         {
         }
 
+        // Robust location step used when mu is concentrated out
+        template <typename T>
+        T location(const Vec<T> &phi, const Vec<T> &theta) const
+        {
+            return profile::robust_location(model, phi, theta);
+        }
+
+        // One-step residuals of a fit, from the BIP recursion of the objective
+        Eigen::VectorXd residuals(const arma_params &params) const
+        {
+            return model.bip_arma_residuals(params.phi, params.theta, params.mu, sigma);
+        }
+
         template <typename T>
         bool operator()(T const *const *parameters, T *residuals) const
         {
             auto [phi, theta, mu] = model.get_params(parameters);
 
-            Vec<T> e = model.bip_arma_residuals(phi, theta, mu, T(sigma)) / T(sigma);
+            Vec<T> e = model.bip_arma_residuals(phi, theta, mu, T(sigma));
 
-            T est = robarma::bip::rho2(e).sum();
+            // Weighted in the reduction, no weighted copy of the residuals
+            T est = T(0);
+            for (int t = 0; t < e.size(); t++)
+                est += model.weight(t) * Rho::rho(e(t) / T(sigma));
             residuals[0] = est;
             return true;
         };
     };
 
-    inline arma_fit bmm(const arma_model &model, const double &sigma, arma_fit &initial)
+    template <typename Rho = robarma::bip::rho2_family>
+    inline arma_fit bmm(const arma_model &model, const double &sigma, arma_fit &initial, const estimation_options &options = {})
     {
-        auto *cost_function = new ceres::DynamicAutoDiffCostFunction<cost, 4>(new cost(model, sigma));
+        auto make_cost = [sigma](const arma_model &m)
+        { return cost<Rho>(m, sigma); };
+
+        ceres::Solver::Options ceres_options;
+        ceres_options.minimizer_type = ceres::LINE_SEARCH;
 
-        ceres::Solver::Options options;
-        options.minimizer_type = ceres::LINE_SEARCH;
+        // IRLS updates mu with the other parameters, so it cannot concentrate mu out
+        if (options.irls && !options.concentrate_mu)
+        {
+            auto residuals = [&model, sigma](const Eigen::VectorXd &phi, const Eigen::VectorXd &theta, double mu, Eigen::MatrixXd &J)
+            { return model.bip_arma_residuals(phi, theta, mu, sigma, J); };
+
+            arma_fit fit = robarma::solver::solve_irls<Rho>(model, initial, estimation_method::bmm, sigma, residuals, cost<Rho>(model, sigma), ceres_options, options.fixed, options.start);
+            if (fit.result.convergence)
+            {
+                robarma::solver::final_residuals(fit, cost<Rho>(model, sigma), options.keep_residuals);
+                fit.result.scale = sigma;
+                return fit;
+            }
+        }
 
-        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::bmm, cost_function, options);
+        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::bmm, make_cost, ceres_options, options);
+        fit.result.scale = sigma;
 
         return fit;
     }
@@ -0,0 +1,168 @@
+/**
+ * @file columns.hpp
+ * @brief Columnar storage of batch fit results.
+ *
+ * One column per field, each preallocated for all series, so a fit costs
+ * 8 (p + q + 3) + 5 bytes instead of an arma_fit with its optional initial parameters,
+ * report and attempts. The coefficients are stored column-major with one row per series:
+ * phi_matrix()(i, j) is phi_{j + 1} of series i.
+ *
+ * Results are stored in the column files of io.hpp, in the same layout as series panels,
+ * with the columns
+ *
+ *     shape (m, p, q), phi, theta, mu, cost, convergence, iterations, seconds
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <arma.hpp>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <io.hpp>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace robarma
+{
+    class fit_columns
+    {
+    public:
+        int m;
+        int p;
+        int q;
+        std::vector<double> phi;
+        std::vector<double> theta;
+        std::vector<double> mu;
+        std::vector<double> cost;
+        std::vector<std::uint8_t> convergence;
+        std::vector<std::int32_t> iterations;
+        std::vector<double> seconds;
+
+        /**
+         * @brief Columns for m fits of an ARMA(p, q) model.
+         *
+         * @param m number of series
+         * @param p
+         * @param q
+         */
+        fit_columns(int m, int p, int q)
+            : m(checked(m, p, q)), p(p), q(q), phi(std::size_t(m) * p), theta(std::size_t(m) * q),
+              mu(m), cost(m), convergence(m), iterations(m), seconds(m)
+        {
+        }
+
+        // m x p matrix of the AR coefficients, one row per series
+        Eigen::Map<const Eigen::MatrixXd> phi_matrix() const
+        {
+            return Eigen::Map<const Eigen::MatrixXd>(phi.data(), m, p);
+        }
+
+        // m x q matrix of the MA coefficients, one row per series
+        Eigen::Map<const Eigen::MatrixXd> theta_matrix() const
+        {
+            return Eigen::Map<const Eigen::MatrixXd>(theta.data(), m, q);
+        }
+
+        // Parameters of series i
+        arma_params params(int i) const
+        {
+            return arma_params(phi_matrix().row(i).transpose(), theta_matrix().row(i).transpose(), mu[i]);
+        }
+
+        /**
+         * @brief Store the fit of series i, as a sink of batch::fit.
+         *
+         * Different series may be stored concurrently.
+         *
+         * @param i
+         * @param fit
+         * @param elapsed wall-clock seconds spent on the fit
+         */
+        void operator()(int i, const arma_fit &fit, double elapsed)
+        {
+            if (fit.params.phi.size() != p || fit.params.theta.size() != q)
+                throw std::invalid_argument("Fit of order (" + std::to_string(fit.params.phi.size()) + ", " + std::to_string(fit.params.theta.size()) + ") does not match the columns.");
+
+            for (int j = 0; j < p; j++)
+                phi[std::size_t(j) * m + i] = fit.params.phi(j);
+            for (int j = 0; j < q; j++)
+                theta[std::size_t(j) * m + i] = fit.params.theta(j);
+            mu[i] = fit.params.mu;
+            cost[i] = fit.result.final_cost;
+            convergence[i] = fit.result.convergence;
+            iterations[i] = fit.result.iterations;
+            seconds[i] = elapsed;
+        }
+
+        void write(std::ostream &out) const
+        {
+            io::writer file(out, io::kind::fits, 8);
+            std::int64_t shape[] = {m, p, q};
+            file.column(shape, 3);
+            file.column(phi);
+            file.column(theta);
+            file.column(mu);
+            file.column(cost);
+            file.column(convergence);
+            file.column(iterations);
+            file.column(seconds);
+        }
+
+        static fit_columns read(std::istream &in)
+        {
+            io::reader file(in, io::kind::fits);
+            std::vector<std::int64_t> shape = file.column<std::int64_t>();
+            if (shape.size() != 3 || *std::min_element(shape.begin(), shape.end()) < 0 || *std::max_element(shape.begin(), shape.end()) > INT_MAX)
+                throw std::runtime_error("Fit file has an invalid shape.");
+
+            // The columns are sized by the file, which bounds them by its length
+            fit_columns columns{0, int(shape[1]), int(shape[2])};
+            columns.m = int(shape[0]);
+            file.column(columns.phi);
+            file.column(columns.theta);
+            file.column(columns.mu);
+            file.column(columns.cost);
+            file.column(columns.convergence);
+            file.column(columns.iterations);
+            file.column(columns.seconds);
+
+            std::size_t n = columns.m;
+            if (columns.phi.size() != n * columns.p || columns.theta.size() != n * columns.q || columns.mu.size() != n || columns.cost.size() != n || columns.convergence.size() != n || columns.iterations.size() != n || columns.seconds.size() != n)
+                throw std::runtime_error("Fit file has inconsistent columns.");
+            return columns;
+        }
+
+        void save(const std::string &path) const
+        {
+            std::ofstream out(path, std::ios::binary);
+            if (!out)
+                throw std::runtime_error("Cannot open " + path + " for writing.");
+            write(out);
+        }
+
+        static fit_columns load(const std::string &path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                throw std::runtime_error("Cannot open " + path + " for reading.");
+            return read(in);
+        }
+
+    private:
+        // Validate the shape before any column is allocated, returning m
+        static int checked(int m, int p, int q)
+        {
+            if (m < 0 || p < 0 || q < 0)
+                throw std::invalid_argument("Fit columns need nonnegative m, p and q.");
+            return m;
+        }
+    };
+} // namespace robarma
+
+// end of file
@@ -0,0 +1,195 @@
+/**
+ * @file covariance.hpp
+ * @brief Asymptotic covariance matrices and standard errors of fitted ARMA models.
+ *
+ * Parameters are ordered as beta = (phi, theta, mu) in all matrices.
+ *
+ *  - OLS (and Hannan-Rissanen): sigma^2 (J'J)^-1 from the residual sensitivities J.
+ *  - MLE: inverse observed information of the concentrated Kalman likelihood; NaN when the
+ *    fit lies so close to the stationarity boundary that the differences leave the region.
+ *  - MM and BIP-MM: sandwich s^2 E[psi^2] / E[psi']^2 (J'J)^-1 as in \cite Muler,
+ *    with psi = rho2' and s the S-estimate of scale the MM objective was minimized with.
+ *    For BIP-MM the residuals and sensitivities J are those of the BIP recursion.
+ *
+ * Parameters held fixed by a mask are dropped from J and from the Hessian before inverting,
+ * and their rows and columns of the covariance are NaN. With observation weights W the
+ * matrices become sandwiches: (J'WJ)^-1 (J'W^2J) (J'WJ)^-1 with weighted residual moments,
+ * and for MLE H_W^-1 H_W2 H_W^-1 with the Hessians of the likelihoods weighted by W and W^2.
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <arma.hpp>
+#include <bip.hpp>
+#include <ceres/ceres.h>
+#include <estimation_result.hpp>
+#include <limits>
+#include <mask.hpp>
+#include <mle.hpp>
+#include <rho.hpp>
+#include <robust.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace robarma
+{
+    namespace detail
+    {
+        // Hessian of the MLE objective by central differences of its autodiff gradient
+        inline Eigen::MatrixXd mle_hessian(const arma_model &model, const arma_params &params)
+        {
+            int p = model.p;
+            int q = model.q;
+            int k = p + q + 1;
+
+            ceres::DynamicAutoDiffCostFunction<mle::cost, 4> cost_function(new mle::cost(model));
+            cost_function.AddParameterBlock(p);
+            cost_function.AddParameterBlock(q);
+            cost_function.AddParameterBlock(1);
+            cost_function.SetNumResiduals(1);
+
+            auto gradient = [&](const Eigen::VectorXd &beta)
+            {
+                Eigen::VectorXd g = Eigen::VectorXd::Zero(k);
+                double value = 0.0;
+                double empty[1] = {0.0};
+                const double *parameters[] = {p ? beta.data() : empty, q ? beta.data() + p : empty, beta.data() + p + q};
+                double *jacobians[] = {p ? g.data() : nullptr, q ? g.data() + p : nullptr, g.data() + p + q};
+                // The likelihood is undefined outside the stationary region; a zero gradient there
+                // would silently bias the differences, so the Hessian becomes NaN instead
+                if (!cost_function.Evaluate(parameters, &value, jacobians))
+                    g.setConstant(std::numeric_limits<double>::quiet_NaN());
+                return g;
+            };
+
+            Eigen::VectorXd beta(k);
+            beta << params.phi, params.theta, params.mu;
+
+            Eigen::MatrixXd H(k, k);
+            for (int i = 0; i < k; i++)
+            {
+                double h = 1e-5 * std::fmax(1.0, std::abs(beta(i)));
+                Eigen::VectorXd up = beta;
+                Eigen::VectorXd down = beta;
+                up(i) += h;
+                down(i) -= h;
+                H.col(i) = (gradient(up) - gradient(down)) / (2.0 * h);
+            }
+            return (H + H.transpose()) / 2.0;
+        }
+    } // namespace detail
+
+    /**
+     * @brief Asymptotic covariance matrix of the estimated parameters.
+     *
+     * Supported for OLS, Hannan-Rissanen, MLE, MM and BIP-MM fits. Costs a single
+     * residual pass with sensitivities, O(n (p + q)^2), plus 2(p + q + 1) gradient
+     * evaluations of the likelihood for MLE, twice that with observation weights.
+     *
+     * @param fit
+     * @param fixed parameter mask the fit was estimated with, see estimation_options::fixed
+     * @return Eigen::MatrixXd of size (p + q + 1) x (p + q + 1), NaN in the rows and columns
+     * of fixed parameters
+     */
+    inline Eigen::MatrixXd covariance(const arma_fit &fit, const Eigen::VectorXd &fixed = Eigen::VectorXd())
+    {
+        const arma_model &model = fit.model;
+        const arma_params &params = fit.params;
+        estimation_method method = fit.result.method;
+
+        int k = model.p + model.q + 1;
+        std::vector<int> free = mask::layout(model, fixed, params).free;
+        int kf = free.size();
+
+        Eigen::MatrixXd cov = Eigen::MatrixXd::Constant(k, k, std::numeric_limits<double>::quiet_NaN());
+        auto restrict = [&](const Eigen::MatrixXd &H)
+        {
+            Eigen::MatrixXd block(kf, kf);
+            for (int i = 0; i < kf; i++)
+                for (int j = 0; j < kf; j++)
+                    block(i, j) = H(free[i], free[j]);
+            return block;
+        };
+        auto scatter = [&](const Eigen::MatrixXd &block)
+        {
+            for (int i = 0; i < kf; i++)
+                for (int j = 0; j < kf; j++)
+                    cov(free[i], free[j]) = block(i, j);
+            return cov;
+        };
+
+        if (method == estimation_method::mle)
+        {
+            // Objective is -2 times the concentrated log-likelihood
+            Eigen::MatrixXd H = restrict(detail::mle_hessian(model, params)) / 2.0;
+            Eigen::MatrixXd Hinv = H.inverse();
+            if (!model.weighted())
+                return scatter(Hinv);
+
+            // set_weights normalizes W^2 to mean one, which scales its Hessian by 1 / mean(W^2)
+            arma_model squared = model;
+            squared.set_weights(model.weights.array().square().matrix());
+            double c = model.weights.array().square().mean();
+            Eigen::MatrixXd H2 = c * restrict(detail::mle_hessian(squared, params)) / 2.0;
+            return scatter(Hinv * H2 * Hinv);
+        }
+
+        if (method != estimation_method::hannan_rissanen && method != estimation_method::ols &&
+            method != estimation_method::mm && method != estimation_method::bmm)
+            throw std::invalid_argument(std::string("Covariance is not available for ") + to_string(method) + " fits.");
+
+        // Scale of the MM objective; fits assembled without it fall back to the M-scale of
+        // the final residuals
+        double s = fit.result.scale;
+        Eigen::MatrixXd J;
+        Eigen::VectorXd e = model.arma_residuals(params.phi, params.theta, params.mu, J);
+
+        int m = model.n - model.r;
+        if ((method == estimation_method::mm || method == estimation_method::bmm) && !std::isfinite(s))
+            s = robarma::rho::scale<robarma::bip::rho1_family>(Eigen::VectorXd(e.tail(m)), Eigen::VectorXd(model.weights.tail(model.weighted() ? m : 0)));
+
+        // BIP-MM residuals and their sensitivities both come from the BIP recursion
+        if (method == estimation_method::bmm)
+            e = model.bip_arma_residuals(params.phi, params.theta, params.mu, s, J);
+
+        Eigen::MatrixXd Jf(m, kf);
+        for (int i = 0; i < kf; i++)
+            Jf.col(i) = J.col(free[i]).tail(m);
+        Eigen::VectorXd w = model.weighted() ? Eigen::VectorXd(model.weights.tail(m)) : Eigen::VectorXd::Ones(m);
+        Eigen::MatrixXd bread = Jf.transpose() * w.asDiagonal() * Jf;
+        Eigen::MatrixXd meat = Jf.transpose() * w.array().square().matrix().asDiagonal() * Jf;
+
+        double factor;
+        if (method == estimation_method::hannan_rissanen || method == estimation_method::ols)
+            factor = w.dot(e.tail(m).array().square().matrix()) / (w.sum() - kf);
+        else
+        {
+            Eigen::VectorXd u = e.tail(m) / s;
+            double psi2 = w.array().square().matrix().dot(robarma::bip::eta(u).array().square().matrix()) / w.squaredNorm();
+            double dpsi = w.dot(robarma::bip::deta(u)) / w.sum();
+            factor = s * s * psi2 / (dpsi * dpsi);
+        }
+
+        Eigen::MatrixXd inverse = bread.inverse();
+        return scatter(factor * inverse * meat * inverse);
+    }
+
+    /**
+     * @brief Asymptotic standard errors of the estimated parameters.
+     *
+     * @param fit
+     * @param fixed parameter mask the fit was estimated with, see estimation_options::fixed
+     * @return arma_params holding the standard errors of phi, theta and mu, NaN for fixed parameters
+     */
+    inline arma_params standard_errors(const arma_fit &fit, const Eigen::VectorXd &fixed = Eigen::VectorXd())
+    {
+        Eigen::VectorXd se = covariance(fit, fixed).diagonal().cwiseSqrt();
+        int p = fit.model.p;
+        int q = fit.model.q;
+        return arma_params(se.segment(0, p), se.segment(p, q), se(p + q));
+    }
+} // namespace robarma
+
+// end of file
@@ -0,0 +1,315 @@
+/**
+ * @file diagnostics.hpp
+ * @brief Robust residual diagnostics for fitted ARMA models.
+ *
+ * Residuals are centered with the median, standardised with MADN and passed
+ * through the Huber psi-function before any second-order statistic is computed,
+ * so that isolated outliers do not dominate the portmanteau test.
+ *
+ *  - robust ACF of psi-transformed residuals
+ *  - robust Ljung-Box statistic and its chi-square p-value
+ *  - Jarque-Bera test on the cleaned residuals (flagged observations removed)
+ *  - fraction of flagged residuals
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <alias.hpp>
+#include <array>
+#include <arma.hpp>
+#include <cmath>
+#include <robust.hpp>
+#include <stdexcept>
+#include <ts.hpp>
+#include <vector>
+
+namespace robarma::diagnostics
+{
+    namespace detail
+    {
+        // Regularized upper incomplete gamma function Q(a, x)
+        inline double gamma_q(double a, double x)
+        {
+            if (x <= 0.0)
+                return 1.0;
+
+            double log_prefix = -x + a * std::log(x) - std::lgamma(a);
+
+            if (x < a + 1.0)
+            {
+                // Series representation of P(a, x)
+                double term = 1.0 / a;
+                double sum = term;
+                for (int n = 1; n < 500; n++)
+                {
+                    term *= x / (a + n);
+                    sum += term;
+                    if (std::abs(term) < std::abs(sum) * 1e-15)
+                        break;
+                }
+                return 1.0 - sum * std::exp(log_prefix);
+            }
+
+            // Continued fraction representation of Q(a, x) (modified Lentz)
+            double tiny = 1e-300;
+            double b = x + 1.0 - a;
+            double c = 1.0 / tiny;
+            double d = 1.0 / b;
+            double h = d;
+            for (int i = 1; i < 500; i++)
+            {
+                double an = -i * (i - a);
+                b += 2.0;
+                d = an * d + b;
+                d = (std::abs(d) < tiny) ? tiny : d;
+                c = b + an / c;
+                c = (std::abs(c) < tiny) ? tiny : c;
+                d = 1.0 / d;
+                double delta = d * c;
+                h *= delta;
+                if (std::abs(delta - 1.0) < 1e-15)
+                    break;
+            }
+            return std::exp(log_prefix) * h;
+        }
+
+        // Upper tail probability of the chi-square distribution
+        inline double chi2_sf(double x, int df)
+        {
+            return gamma_q(df / 2.0, x / 2.0);
+        }
+
+        // Even moments E x^2, E x^4, E x^6, E x^8 of a standard normal truncated to [-c, c],
+        // from E x^2k = (2k - 1) E x^(2k - 2) - 2 c^(2k - 1) phi(c) / P(|x| <= c)
+        inline std::array<double, 4> truncated_normal_moments(double c)
+        {
+            constexpr double pi = 3.14159265358979323846;
+            double tail = 2.0 * std::exp(-c * c / 2.0) / std::sqrt(2.0 * pi) / std::erf(c / std::sqrt(2.0));
+            std::array<double, 4> mu;
+            double previous = 1.0;
+            for (int k = 1; k <= 4; k++)
+            {
+                mu[k - 1] = (2 * k - 1) * previous - std::pow(c, 2 * k - 1) * tail;
+                previous = mu[k - 1];
+            }
+            return mu;
+        }
+
+        /**
+         * @brief Null variances of the skewness and kurtosis of the cleaned residuals.
+         *
+         * Under Gaussian residuals the cleaned sample is a normal truncated to
+         * [median - c MADN, median + c MADN]. The asymptotic variances, per residual before
+         * cleaning, follow from the influence functions of the skewness and kurtosis of the
+         * truncated sample plus those of the median, which shifts the interval and skews the
+         * sample, and of MADN, which moves the truncation point and with it the kurtosis. The
+         * two statistics are uncorrelated by symmetry. Without truncation they are 6 and 24.
+         *
+         * @param c cutoff in MADN units
+         * @return {variance of the skewness, variance of the kurtosis}
+         */
+        inline std::array<double, 2> jarque_bera_variances(double c)
+        {
+            constexpr double pi = 3.14159265358979323846;
+            constexpr double q = 0.6745;
+            auto density = [](double x)
+            { return std::exp(-x * x / 2.0) / std::sqrt(2.0 * pi); };
+            auto mass = [](double x)
+            { return std::erf(x / std::sqrt(2.0)); };
+
+            auto [mu2, mu4, mu6, mu8] = truncated_normal_moments(c);
+            double p = mass(c);
+            double tail = 2.0 * density(c) / p;
+
+            // Skewness: truncated sample, plus the median through the shift of the interval,
+            // with d skewness / d shift = tail (c^3 - 3 c mu2) / mu2^(3/2)
+            double shift = tail * (std::pow(c, 3) - 3.0 * c * mu2) / std::pow(mu2, 1.5);
+            double median = 1.0 / (2.0 * density(0.0));
+            double abs1 = 2.0 * (density(0.0) - density(c));
+            double abs3 = 2.0 * (2.0 * density(0.0) - (c * c + 2.0) * density(c));
+            double skewness = (mu6 - 6.0 * mu2 * mu4 + 9.0 * std::pow(mu2, 3)) / (p * std::pow(mu2, 3)) +
+                              2.0 * (abs3 - 3.0 * mu2 * abs1) / (p * std::pow(mu2, 1.5)) * shift * median +
+                              shift * shift * median * median;
+
+            // Kurtosis: truncated sample, plus MADN through the truncation point, with
+            // d mu_k / dc = tail (c^k - mu_k)
+            double beta = mu4 / mu2;
+            double slope = c * (tail * (std::pow(c, 4) - mu4) / (mu2 * mu2) - 2.0 * mu4 * tail * (c * c - mu2) / std::pow(mu2, 3));
+            double scale = 1.0 / (4.0 * q * density(q));
+            auto [nu2, nu4, nu6, nu8] = truncated_normal_moments(q);
+            double inner = -2.0 * mass(q) * ((nu4 - mu4) - 2.0 * beta * (nu2 - mu2)) / (mu2 * mu2);
+            double kurtosis = (mu8 - mu4 * mu4 - 4.0 * beta * (mu6 - mu4 * mu2) + 4.0 * beta * beta * (mu4 - mu2 * mu2)) / (p * std::pow(mu2, 4)) +
+                              2.0 * slope * scale * inner / p +
+                              slope * slope * scale * scale;
+            return {skewness, kurtosis};
+        }
+    } // namespace detail
+
+    /**
+     * @brief Diagnostics of a single residual series.
+     *
+     *  - acf: robust autocorrelations at lags 1, ..., L
+     *  - ljung_box, ljung_box_pvalue, df: robust portmanteau test with L - (p + q) degrees of freedom
+     *  - jarque_bera, jarque_bera_pvalue: normality test on the cleaned residuals, scaled by the
+     *    null variances of the truncated moments so the p-value is chi-square(2)
+     *  - flagged_fraction: fraction of residuals beyond the cutoff in MADN units
+     */
+    struct residual_diagnostics
+    {
+        Eigen::VectorXd acf;
+        double ljung_box;
+        double ljung_box_pvalue;
+        int df;
+        double jarque_bera;
+        double jarque_bera_pvalue;
+        double flagged_fraction;
+    };
+
+    /**
+     * @brief Diagnostics of a whole panel of fits in columnar form.
+     *
+     * Row i of acf and element i of the vectors belong to fit i.
+     */
+    struct panel_diagnostics
+    {
+        Eigen::MatrixXd acf;
+        Eigen::VectorXd ljung_box;
+        Eigen::VectorXd ljung_box_pvalue;
+        Eigen::VectorXd jarque_bera;
+        Eigen::VectorXd jarque_bera_pvalue;
+        Eigen::VectorXd flagged_fraction;
+    };
+
+    // Residuals centered with the median and standardised with MADN, or with the normalized
+    // mean absolute deviation when more than half of them are tied at the median
+    inline Eigen::VectorXd standardize(const Eigen::VectorXd &e)
+    {
+        double med = robarma::base::median(e);
+        Eigen::VectorXd deviation = (e.array() - med).abs();
+        constexpr double pi = 3.14159265358979323846;
+        double s = robarma::base::median(deviation) / 0.6745;
+        if (!(s > 0.0))
+            s = deviation.mean() * std::sqrt(pi / 2.0);
+        if (!(s > 0.0))
+            throw std::invalid_argument("Residuals are constant; diagnostics are undefined.");
+        return (e.array() - med) / s;
+    }
+
+    /**
+     * @brief Robust autocorrelation function of residuals at lags 1, ..., L.
+     *
+     * @param e residuals
+     * @param lags maximum lag L
+     * @return Eigen::VectorXd
+     */
+    inline Eigen::VectorXd robust_acf(const Eigen::VectorXd &e, int lags)
+    {
+        Eigen::VectorXd psi = robarma::base::huber<double>(standardize(e));
+        Eigen::VectorXd gamma = robarma::autocov<double>(psi, lags, 0.0);
+        return gamma.tail(lags) / gamma(0);
+    }
+
+    /**
+     * @brief Robust residual diagnostics.
+     *
+     * @param e residuals
+     * @param lags number of autocorrelations in the portmanteau statistic
+     * @param fitdf number of estimated ARMA coefficients, p + q
+     * @param cutoff residuals beyond cutoff * MADN are flagged and removed before the normality test
+     * @return residual_diagnostics
+     */
+    inline residual_diagnostics diagnose(const Eigen::VectorXd &e, int lags, int fitdf, double cutoff = 3.0)
+    {
+        residual_diagnostics d;
+        int n = e.size();
+
+        Eigen::VectorXd u = standardize(e);
+        Eigen::VectorXd psi = robarma::base::huber<double>(u);
+        Eigen::VectorXd gamma = robarma::autocov<double>(psi, lags, 0.0);
+        d.acf = gamma.tail(lags) / gamma(0);
+
+        double q = 0.0;
+        for (int k = 1; k <= lags; k++)
+            q += d.acf(k - 1) * d.acf(k - 1) / double(n - k);
+        d.ljung_box = double(n) * (n + 2) * q;
+        d.df = std::max(lags - fitdf, 1);
+        d.ljung_box_pvalue = detail::chi2_sf(d.ljung_box, d.df);
+
+        Eigen::Array<bool, Eigen::Dynamic, 1> keep = u.array().abs() <= cutoff;
+        int m = keep.count();
+        d.flagged_fraction = 1.0 - double(m) / n;
+
+        Eigen::VectorXd clean(m);
+        for (int i = 0, j = 0; i < n; i++)
+            if (keep(i))
+                clean(j++) = u(i);
+
+        Eigen::ArrayXd c = clean.array() - clean.mean();
+        double m2 = c.square().mean();
+        double skewness = c.cube().mean() / std::pow(m2, 1.5);
+        double kurtosis = c.square().square().mean() / (m2 * m2);
+
+        // Compare against the truncated normal, as the cleaning removes its tails, with the
+        // null variances of the cleaned moments, so the statistic is again chi-square(2)
+        auto [mu2, mu4, mu6, mu8] = detail::truncated_normal_moments(cutoff);
+        auto [skewness_variance, kurtosis_variance] = detail::jarque_bera_variances(cutoff);
+        double excess = kurtosis - mu4 / (mu2 * mu2);
+        d.jarque_bera = n * (skewness * skewness / skewness_variance + excess * excess / kurtosis_variance);
+        d.jarque_bera_pvalue = detail::chi2_sf(d.jarque_bera, 2);
+
+        return d;
+    }
+
+    /**
+     * @brief Robust residual diagnostics of a fit.
+     *
+     * Uses the residuals cached on the fit and computes them only when missing.
+     *
+     * @param fit
+     * @param lags
+     * @param cutoff
+     * @return residual_diagnostics
+     */
+    inline residual_diagnostics diagnose(const arma_fit &fit, int lags = 10, double cutoff = 3.0)
+    {
+        const arma_model &model = fit.model;
+        Eigen::VectorXd e = fit.residuals ? *fit.residuals : model.arma_residuals(fit.params.phi, fit.params.theta, fit.params.mu);
+        return diagnose(Eigen::VectorXd(e.tail(model.n - model.r)), lags, model.p + model.q, cutoff);
+    }
+
+    /**
+     * @brief Robust residual diagnostics of a panel of fits.
+     *
+     * @param fits
+     * @param lags
+     * @param cutoff
+     * @return panel_diagnostics
+     */
+    inline panel_diagnostics diagnose(const std::vector<arma_fit> &fits, int lags = 10, double cutoff = 3.0)
+    {
+        int count = fits.size();
+
+        panel_diagnostics d;
+        d.acf.resize(count, lags);
+        d.ljung_box.resize(count);
+        d.ljung_box_pvalue.resize(count);
+        d.jarque_bera.resize(count);
+        d.jarque_bera_pvalue.resize(count);
+        d.flagged_fraction.resize(count);
+
+        for (int i = 0; i < count; i++)
+        {
+            residual_diagnostics di = diagnose(fits[i], lags, cutoff);
+            d.acf.row(i) = di.acf.transpose();
+            d.ljung_box(i) = di.ljung_box;
+            d.ljung_box_pvalue(i) = di.ljung_box_pvalue;
+            d.jarque_bera(i) = di.jarque_bera;
+            d.jarque_bera_pvalue(i) = di.jarque_bera_pvalue;
+            d.flagged_fraction(i) = di.flagged_fraction;
+        }
+        return d;
+    }
+} // namespace robarma::diagnostics
+
+// end of file
@@ -16,6 +16,10 @@
 #include <array>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
 
 namespace robarma
 {
@@ -34,13 +38,14 @@ namespace robarma
         bs,
         mm,
         bmm,
+        robust_yw,
         count // Helper to get the number of methods
     };
 
     inline const char *to_string(estimation_method method)
     {
         static constexpr std::array<const char *, static_cast<size_t>(estimation_method::count)> names{
-            "Hannan-Rissanen", "OLS", "MLE", "FTAU", "S", "BS", "MM", "BMM"};
+            "Hannan-Rissanen", "OLS", "MLE", "FTAU", "S", "BS", "MM", "BMM", "Robust-YW"};
         size_t idx = static_cast<size_t>(method);
         if (idx < names.size())
             return names[idx];
@@ -52,6 +57,18 @@ namespace robarma
         return os << to_string(method);
     }
 
+    /**
+     * @brief One solve of an estimation, as recorded by the fallback ladder.
+     */
+    struct estimation_attempt
+    {
+        std::string strategy;
+        bool convergence;
+        double final_cost;
+        int iterations;
+        int evaluations;
+    };
+
     /**
      * @brief Stores the outcome of an ARMA parameter estimation.
      *
@@ -60,6 +77,12 @@ namespace robarma
      *  - convergence: whether the optimizer converged
      *  - final_cost: objective function value (as we return only one value, Ceres gives the correct value, not squared one)
      *  - report: (optional) optimizer report string
+     *  - iterations: optimizer iterations on the full series
+     *  - evaluations: objective (and gradient) evaluations on the full series
+     *  - subsample_evaluations: evaluations spent on coarse subsamples, in full-length equivalents
+     *  - attempts: solves on the full series, the first one and any fallback retries
+     *  - scale: fixed scale sigma of the MM and BIP-MM objectives, the S-estimate they start
+     *    from; NaN for other methods
      *
      * Used in arma_fit to track both initial and final estimation results.
      */
@@ -70,6 +93,11 @@ namespace robarma
         bool convergence;
         double final_cost;
         std::string report;
+        int iterations = 0;
+        int evaluations = 0;
+        double subsample_evaluations = 0.0;
+        std::vector<estimation_attempt> attempts;
+        double scale = std::numeric_limits<double>::quiet_NaN();
 
         estimation_result() {}
 
@@ -112,6 +140,24 @@ namespace robarma
                << std::left
                << std::setw(20) << "final cost";
             os << format_number(params.final_cost) << "\n";
+            os << std::left
+               << std::setw(20) << "iterations" << params.iterations << "\n";
+            os << std::left
+               << std::setw(20) << "evaluations" << params.evaluations << "\n";
+            if (params.subsample_evaluations > 0.0)
+            {
+                os << std::left
+                   << std::setw(20) << "subsample evals" << format_number(params.subsample_evaluations) << "\n";
+            }
+            if (params.attempts.size() > 1)
+            {
+                for (const estimation_attempt &attempt : params.attempts)
+                {
+                    os << std::left
+                       << std::setw(20) << "attempt" << std::setw(24) << attempt.strategy
+                       << format_bool(attempt.convergence) << format_number(attempt.final_cost) << attempt.evaluations << "\n";
+                }
+            }
             return os;
         };
     };
@@ -5,7 +5,8 @@
  * @brief High-level ARMA(p, q)-estimators
  *
  * Provides entry points for fitting ARMA models using various estimation methods:
- *  - OLS, MLE, FTAU, S, MM, BIP-MM, BIP-S, etc.
+ *  - OLS, MLE, FTAU, S, MM, BIP-MM, BIP-S, robust Yule-Walker, etc.
+ *  - auto_fit, which selects a classic or robust estimator from a contamination pre-screen
  *
  * Each estimator returns an arma_fit object, encapsulating the model, parameters, and results.
  * These functions orchestrate the use of initial estimators and Ceres optimization.
@@ -19,12 +20,20 @@
 
 #include <bip_s.hpp>
 #include <bmm.hpp>
+#include <covariance.hpp>
+#include <diagnostics.hpp>
 #include <estimation_result.hpp>
 #include <ftau.hpp>
 #include <mle.hpp>
 #include <mm.hpp>
 #include <ols.hpp>
+#include <options.hpp>
+#include <rho.hpp>
 #include <s.hpp>
+#include <stdexcept>
+#include <string>
+#include <ts.hpp>
+#include <vector>
 
 /**
  * @namespace robarma::estimators
@@ -41,19 +50,21 @@ namespace robarma::estimators
      * Fit an ARMA(p, q) process using ordinary least squares estimator.
      *
      * @param model
+     * @param options
      * @return arma_fit
      */
-    inline arma_fit ols(const arma_model &model)
+    inline arma_fit ols(const arma_model &model, const estimation_options &options = {})
     {
         arma_fit initial = robarma::initial::hannan_rissanen(model);
 
-        auto *cost_function = new ceres::DynamicAutoDiffCostFunction<ols::cost, 4>(new ols::cost(model));
-
         // With trust-region minimizer, every solution is equal to initial estimate of Hannan-Rissanen.
-        ceres::Solver::Options options;
-        options.minimizer_type = ceres::LINE_SEARCH;
+        ceres::Solver::Options ceres_options;
+        ceres_options.minimizer_type = ceres::LINE_SEARCH;
+
+        auto make_cost = [](const arma_model &m)
+        { return ols::cost(m); };
 
-        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::ols, cost_function, options);
+        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::ols, make_cost, ceres_options, options);
 
         return fit;
     }
@@ -64,18 +75,20 @@ namespace robarma::estimators
      * Fit an ARMA(p, q) process using maximum likelihood estimator.
      * See \cite HarveyPhillips1979
      * @param model
+     * @param options
      * @return arma_fit
      */
-    inline arma_fit mle(const arma_model &model)
+    inline arma_fit mle(const arma_model &model, const estimation_options &options = {})
     {
         arma_fit initial = robarma::initial::hannan_rissanen(model);
 
-        auto *cost_function = new ceres::DynamicAutoDiffCostFunction<mle::cost, 4>(new mle::cost(model));
+        ceres::Solver::Options ceres_options;
+        ceres_options.minimizer_type = ceres::LINE_SEARCH;
 
-        ceres::Solver::Options options;
-        options.minimizer_type = ceres::LINE_SEARCH;
+        auto make_cost = [](const arma_model &m)
+        { return mle::cost(m); };
 
-        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::mle, cost_function, options);
+        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::mle, make_cost, ceres_options, options);
 
         return fit;
     }
@@ -86,19 +99,23 @@ namespace robarma::estimators
      * Fit an ARMA(p, q) process using filtered tau-estimator.
      * See \cite Bianco
 
+     * @tparam Pair rho-functions of the tau-scale and the filter, see rho::tau_pair
      * @param model
+     * @param options
      * @return arma_fit
      */
-    inline arma_fit ftau(const arma_model &model)
+    template <typename Pair = robarma::rho::tau_pair<>>
+    inline arma_fit ftau(const arma_model &model, const estimation_options &options = {})
     {
         arma_fit initial = robarma::initial::hannan_rissanen(model);
 
-        auto *cost_function = new ceres::DynamicAutoDiffCostFunction<ftau::cost, 4>(new ftau::cost(model));
+        ceres::Solver::Options ceres_options;
+        ceres_options.minimizer_type = ceres::LINE_SEARCH;
 
-        ceres::Solver::Options options;
-        options.minimizer_type = ceres::LINE_SEARCH;
+        auto make_cost = [](const arma_model &m)
+        { return ftau::cost<Pair>(m); };
 
-        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::ftau, cost_function, options);
+        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::ftau, make_cost, ceres_options, options);
 
         return fit;
     }
@@ -108,20 +125,24 @@ namespace robarma::estimators
      *
      * Fit an ARMA(p, q) process using S-estimator.
      * Definition and rho-functions are as shown in \cite Muler
+     * @tparam Rho bounded rho family of the M-scale, see rho.hpp
      * @param model
+     * @param options
      * @return arma_fit
      */
-    inline arma_fit s(const arma_model &model)
+    template <typename Rho = robarma::bip::rho1_family>
+    inline arma_fit s(const arma_model &model, const estimation_options &options = {})
     {
         arma_fit initial = robarma::initial::hannan_rissanen(model);
 
-        auto *cost_function = new ceres::DynamicAutoDiffCostFunction<s::cost, 4>(new s::cost(model));
-
         // Unstable without line_search
-        ceres::Solver::Options options;
-        options.minimizer_type = ceres::LINE_SEARCH;
+        ceres::Solver::Options ceres_options;
+        ceres_options.minimizer_type = ceres::LINE_SEARCH;
 
-        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::s, cost_function, options);
+        auto make_cost = [](const arma_model &m)
+        { return s::cost<Rho>(m); };
+
+        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::s, make_cost, ceres_options, options);
 
         return fit;
     }
@@ -131,21 +152,20 @@ namespace robarma::estimators
      *
      * Fit an ARMA(p, q) process using filtered MM-estimator.
      * Definition and rho-functions are as shown in \cite Muler
+     * @tparam Rho1 rho family of the initial S-scale
+     * @tparam Rho2 rho family of the MM objective
      * @param model
+     * @param options
      * @return arma_fit
      */
-    inline arma_fit mm(const arma_model &model)
+    template <typename Rho1 = robarma::bip::rho1_family, typename Rho2 = robarma::bip::rho2_family>
+    inline arma_fit mm(const arma_model &model, const estimation_options &options = {})
     {
-        arma_fit initial = robarma::estimators::s(model);
+        arma_fit initial = robarma::estimators::s<Rho1>(model, options);
 
         double sigma = initial.result.final_cost;
 
-        auto *cost_function = new ceres::DynamicAutoDiffCostFunction<mm::cost, 4>(new mm::cost(model, sigma));
-
-        ceres::Solver::Options options;
-        options.minimizer_type = ceres::LINE_SEARCH;
-
-        arma_fit fit = robarma::solver::solve(model, initial, estimation_method::mm, cost_function, options);
+        arma_fit fit = robarma::mm::mm<Rho2>(model, sigma, initial, options);
 
         return fit;
     }
@@ -155,27 +175,166 @@ namespace robarma::estimators
      *
      * Fit an ARMA(p, q) process using filtered BIP-MM-estimator.
      * Definition and rho-functions are as shown in \cite Muler
+     * @tparam Rho1 rho family of the initial S-scales
+     * @tparam Rho2 rho family of the MM objectives
      * @param model
+     * @param options
      * @return arma_fit
      */
-    inline arma_fit bip_mm(const arma_model &model)
+    template <typename Rho1 = robarma::bip::rho1_family, typename Rho2 = robarma::bip::rho2_family>
+    inline arma_fit bip_mm(const arma_model &model, const estimation_options &options = {})
     {
         // Step 1.
-        arma_fit s_mm = robarma::estimators::s(model);
-        arma_fit s_bmm = robarma::estimators::bip_s(model);
+        arma_fit s_mm = robarma::estimators::s<Rho1>(model, options);
+        arma_fit s_bmm = robarma::estimators::bip_s<Rho1>(model, options);
 
         // Step 2.
         double sigma = fmin(s_mm.result.final_cost, s_bmm.result.final_cost);
 
         // Step 3.
-        arma_fit fit_mm = robarma::mm::mm(model, sigma, s_mm);
-        arma_fit fit_bmm = robarma::bmm::bmm(model, sigma, s_bmm);
+        arma_fit fit_mm = robarma::mm::mm<Rho2>(model, sigma, s_mm, options);
+        arma_fit fit_bmm = robarma::bmm::bmm<Rho2>(model, sigma, s_bmm, options);
 
         double m = fit_mm.result.final_cost;
         double mb = fit_bmm.result.final_cost;
 
         return (m < mb) ? fit_mm : fit_bmm;
     }
+
+    /**
+     * @brief Robust Yule-Walker estimator
+     *
+     * Direct, non-iterative robust estimator intended for screening. Robust
+     * autocovariances from robust scales of sums and differences of lagged pairs
+     * are turned into ARMA coefficients with Durbin-Levinson and the innovations
+     * algorithm. Costs O(n (p + q) + m^2).
+     *
+     * @param model
+     * @return arma_fit
+     */
+    inline arma_fit robust_yw(const arma_model &model)
+    {
+        return robarma::initial::robust_yule_walker(model);
+    }
+
+    /**
+     * @brief Robust Yule-Walker estimator for a panel of models
+     *
+     * @param models
+     * @return std::vector<arma_fit> with fit i referring to models[i]
+     */
+    inline std::vector<arma_fit> robust_yw(const std::vector<arma_model> &models)
+    {
+        std::vector<arma_fit> fits;
+        fits.reserve(models.size());
+        for (const arma_model &model : models)
+        {
+            fits.push_back(robust_yw(model));
+        }
+        return fits;
+    }
+    /**
+     * @brief Fit with the estimator selected at run time
+     *
+     * @param model
+     * @param method
+     * @param options
+     * @return arma_fit
+     */
+    inline arma_fit fit(const arma_model &model, estimation_method method, const estimation_options &options = {})
+    {
+        switch (method)
+        {
+        case estimation_method::hannan_rissanen:
+            return robarma::initial::hannan_rissanen(model);
+        case estimation_method::ols:
+            return robarma::estimators::ols(model, options);
+        case estimation_method::mle:
+            return robarma::estimators::mle(model, options);
+        case estimation_method::ftau:
+            return robarma::estimators::ftau(model, options);
+        case estimation_method::s:
+            return robarma::estimators::s(model, options);
+        case estimation_method::bs:
+            return robarma::estimators::bip_s(model, options);
+        case estimation_method::mm:
+            return robarma::estimators::mm(model, options);
+        case estimation_method::bmm:
+            return robarma::estimators::bip_mm(model, options);
+        case estimation_method::robust_yw:
+            return robarma::estimators::robust_yw(model);
+        default:
+            throw std::invalid_argument(std::string("Cannot fit with ") + to_string(method) + ".");
+        }
+    }
+
+    /**
+     * @brief Contamination pre-screen
+     *
+     * Compares the classical and robust (MADN) scales of the Hannan-Rissanen residuals
+     * and counts residuals beyond selection.cutoff robust scales. Costs one Hannan-Rissanen
+     * fit and a residual pass.
+     *
+     * @param model
+     * @param selection
+     * @return contamination_screen
+     */
+    inline contamination_screen screen(const arma_model &model, const selection_options &selection = {})
+    {
+        arma_fit hr = robarma::initial::hannan_rissanen(model);
+        Eigen::VectorXd e = model.arma_residuals(hr.params.phi, hr.params.theta, hr.params.mu).tail(model.n - model.r);
+        int m = e.size();
+
+        double med = robarma::base::median(e);
+        Eigen::ArrayXd deviation = (e.array() - med).abs();
+
+        contamination_screen decision;
+        decision.robust_scale = robarma::base::median(deviation) / 0.6745;
+        decision.classical_scale = std::sqrt((e.array() - e.mean()).square().sum() / (m - 1));
+        decision.scale_ratio = decision.classical_scale / decision.robust_scale;
+        decision.flagged_fraction = (deviation > selection.cutoff * decision.robust_scale).count() / double(m);
+        decision.contaminated = !(decision.scale_ratio <= selection.scale_ratio) || decision.flagged_fraction > selection.flagged_fraction;
+        decision.selected = decision.contaminated ? selection.robust : selection.classical;
+        return decision;
+    }
+
+    /**
+     * @brief Adaptive estimator
+     *
+     * Runs the contamination pre-screen and fits with the classical estimator when
+     * contamination is negligible, otherwise with the robust one. The screen and the
+     * decision are recorded in arma_fit::screen.
+     *
+     * @param model
+     * @param selection
+     * @param options
+     * @return arma_fit
+     */
+    inline arma_fit auto_fit(const arma_model &model, const selection_options &selection = {}, const estimation_options &options = {})
+    {
+        auto dispatch = [&](estimation_method method)
+        {
+            switch (method)
+            {
+            case estimation_method::ols:
+                return robarma::estimators::ols(model, options);
+            case estimation_method::mle:
+                return robarma::estimators::mle(model, options);
+            case estimation_method::mm:
+                return robarma::estimators::mm(model, options);
+            case estimation_method::bmm:
+                return robarma::estimators::bip_mm(model, options);
+            default:
+                throw std::invalid_argument(std::string("auto_fit cannot dispatch to ") + to_string(method) + ".");
+            }
+        };
+
+        contamination_screen decision = screen(model, selection);
+
+        arma_fit fit = dispatch(decision.selected);
+        fit.screen = decision;
+        return fit;
+    }
 } // namespace robarma::estimators
 
 // end of file
\ No newline at end of file
@@ -0,0 +1,197 @@
+/**
+ * @file forecast.hpp
+ * @brief Streaming ARMA filter and forecasts with empirical prediction intervals.
+ *
+ * The filter keeps the last p observations, the last q residuals and a quantile sketch of
+ * all residuals seen, so a series is carried in O(1) memory. Prediction intervals are
+ * empirical: the residual quantiles from the sketch, rather than Gaussian quantiles, are
+ * scaled to the h-step horizon by
+ *
+ *     sqrt(psi_0^2 + ... + psi_{h-1}^2)
+ *
+ * with the MA(infinity) weights psi_j, which is exact for h = 1 and keeps the shape of the
+ * residual distribution for longer horizons.
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <arma.hpp>
+#include <cmath>
+#include <sketch.hpp>
+#include <stdexcept>
+#include <string>
+
+namespace robarma
+{
+    /**
+     * @brief Point forecasts and empirical prediction intervals.
+     *
+     *  - mean: point forecasts for horizons 1, ..., h
+     *  - lower, upper: interval bounds at the given level
+     *  - level: nominal coverage of the intervals
+     */
+    struct forecast_result
+    {
+        Eigen::VectorXd mean;
+        Eigen::VectorXd lower;
+        Eigen::VectorXd upper;
+        double level;
+    };
+
+    /**
+     * @brief One-step ARMA filter over a stream of observations.
+     *
+     * Started from a fit, it continues the residual recursion of arma_model::arma_residuals
+     * past the end of the series and updates the residual sketch with every new residual.
+     */
+    class arma_filter
+    {
+    public:
+        arma_params params;
+
+        /**
+         * @brief Continue the residual recursion of a fitted model.
+         *
+         * Uses the residuals and the sketch cached by the solver, or recomputes them when
+         * the fit does not carry them.
+         *
+         * @param fit
+         */
+        explicit arma_filter(const arma_fit &fit)
+            : params(fit.params)
+        {
+            const arma_model &model = fit.model;
+            int p = model.p;
+            int q = model.q;
+
+            Eigen::VectorXd e = fit.residuals ? *fit.residuals : model.arma_residuals(params.phi, params.theta, params.mu);
+            if (e.size() < std::max(p, q))
+                throw std::invalid_argument("Series of length " + std::to_string(e.size()) + " is too short to start an ARMA(" + std::to_string(p) + ", " + std::to_string(q) + ") filter.");
+
+            // Most recent first
+            y_lags = model.y.tail(p).reverse();
+            e_lags = e.tail(q).reverse();
+
+            if (fit.residual_quantiles)
+                quantiles = *fit.residual_quantiles;
+            else
+                for (int t = model.r; t < model.n; t++)
+                    quantiles.insert(e(t));
+        }
+
+        /**
+         * @brief Filter one new observation.
+         *
+         * @param y
+         * @return double one-step residual of y
+         */
+        double update(double y)
+        {
+            double e = y - predict();
+            quantiles.insert(e);
+            shift(y_lags, y);
+            shift(e_lags, e);
+            return e;
+        }
+
+        // One-step point forecast of the next observation
+        double predict() const
+        {
+            return params.mu * (1.0 - params.phi.sum()) + params.phi.dot(y_lags) + params.theta.dot(e_lags);
+        }
+
+        /**
+         * @brief Forecasts for horizons 1, ..., h with empirical prediction intervals.
+         *
+         * @param h forecast horizon
+         * @param level nominal coverage of the intervals, in (0, 1)
+         * @return forecast_result
+         */
+        forecast_result forecast(int h, double level = 0.95) const
+        {
+            if (h < 1)
+                throw std::invalid_argument("Forecast horizon must be positive, got " + std::to_string(h) + ".");
+            if (!(level > 0.0 && level < 1.0))
+                throw std::invalid_argument("Interval level must lie in (0, 1), got " + std::to_string(level) + ".");
+
+            int p = params.phi.size();
+            int q = params.theta.size();
+            double level_term = params.mu * (1.0 - params.phi.sum());
+
+            forecast_result result{Eigen::VectorXd(h), Eigen::VectorXd(h), Eigen::VectorXd(h), level};
+
+            // Future residuals are zero; past observations are replaced by forecasts as the horizon grows
+            Eigen::VectorXd y_path = y_lags;
+            Eigen::VectorXd e_path = e_lags;
+            for (int k = 0; k < h; k++)
+            {
+                double value = level_term + params.phi.dot(y_path) + params.theta.dot(e_path);
+                result.mean(k) = value;
+                shift(y_path, value);
+                shift(e_path, 0.0);
+            }
+
+            // MA(infinity) weights psi_0, ..., psi_{h-1}
+            Eigen::VectorXd psi = Eigen::VectorXd::Zero(h);
+            psi(0) = 1.0;
+            for (int j = 1; j < h; j++)
+            {
+                psi(j) = (j <= q) ? params.theta(j - 1) : 0.0;
+                for (int i = 1; i <= std::min(j, p); i++)
+                    psi(j) += params.phi(i - 1) * psi(j - i);
+            }
+
+            double alpha = (1.0 - level) / 2.0;
+            double lower = quantiles.quantile(alpha);
+            double upper = quantiles.quantile(1.0 - alpha);
+
+            double variance = 0.0;
+            for (int k = 0; k < h; k++)
+            {
+                variance += psi(k) * psi(k);
+                double factor = std::sqrt(variance);
+                result.lower(k) = result.mean(k) + factor * lower;
+                result.upper(k) = result.mean(k) + factor * upper;
+            }
+            return result;
+        }
+
+        const sketch::kll &residual_quantiles() const
+        {
+            return quantiles;
+        }
+
+    private:
+        Eigen::VectorXd y_lags;
+        Eigen::VectorXd e_lags;
+        sketch::kll quantiles;
+
+        // Push value to the front of a most-recent-first lag window
+        static void shift(Eigen::VectorXd &lags, double value)
+        {
+            int m = lags.size();
+            if (m == 0)
+                return;
+            for (int i = m - 1; i > 0; i--)
+                lags(i) = lags(i - 1);
+            lags(0) = value;
+        }
+    };
+
+    /**
+     * @brief Forecasts of a fitted model with empirical prediction intervals.
+     *
+     * @param fit
+     * @param h forecast horizon
+     * @param level nominal coverage of the intervals
+     * @return forecast_result
+     */
+    inline forecast_result forecast(const arma_fit &fit, int h, double level = 0.95)
+    {
+        return arma_filter(fit).forecast(h, level);
+    }
+} // namespace robarma
+
+// end of file
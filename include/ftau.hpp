@@ -2,11 +2,19 @@
 
 #include <alias.hpp>
 #include <arma.hpp>
+#include <profile.hpp>
+#include <rho.hpp>
 #include <state_space_cost.hpp>
 #include <tau.hpp>
 
 namespace robarma::ftau
 {
+    /**
+     * @brief Filtered tau objective.
+     *
+     * @tparam Pair rho-functions of the tau-scale and the filter, see rho::tau_pair
+     */
+    template <typename Pair = robarma::rho::tau_pair<>>
     struct cost : public robarma::state_space_cost
     {
         cost(arma_model model)
@@ -15,25 +23,41 @@ namespace robarma::ftau
         }
 
         template <typename T>
-        void predict(Vec<T> &a, Mat<T> &P, const Mat<T> F, const Vec<T> H, const T sigma, const Vec<T> c) const
+        void predict(Vec<T> &a, Mat<T> &P, const Vec<T> &phi, const Vec<T> &H, const T sigma, const Vec<T> &c) const
         {
-            a = (F * a) + c;
-            P = (F * P * F.transpose()) + (pow(sigma, 2) * H * H.transpose());
+            companion_predict(a, P, phi, H, T(pow(sigma, 2)), c);
         }
 
         template <typename T>
         void update(Vec<T> &a, Mat<T> &P, const T u, const T s, const Vec<T> mt) const
         {
-            a = a + ((mt / s) * tau::psi(u / s));
-            P = P - (mt * mt.transpose() / pow(s, 2) * tau::w(u / s));
+            a = a + ((mt / s) * tau::psi<T, Pair>(u / s));
+            P = P - (mt * mt.transpose() / pow(s, 2) * tau::w<T, Pair>(u / s));
         }
 
         template <typename T>
         T loss(Vec<T> u, Vec<T> a) const
         {
-            T S = tau::tau2<T>(u.array() / a.array());
-            T log_likelihood = (T)model.n * log(S) + a.array().square().log().sum();
-            return log_likelihood;
+            if (!model.weighted())
+            {
+                T S = tau::tau2<T, Pair>(u.array() / a.array());
+                T log_likelihood = (T)model.n * log(S) + a.array().square().log().sum();
+                return log_likelihood;
+            }
+
+            // Weighted tau-scale and weighted log-variance contributions
+            T S = tau::tau2<T, Pair>(u.array() / a.array(), model.weights);
+            T log_a = T(0);
+            for (int t = 0; t < a.size(); t++)
+                log_a += model.weights(t) * log(a(t) * a(t));
+            return (T)model.n * log(S) + log_a;
+        }
+
+        // Robust location step used when mu is concentrated out
+        template <typename T>
+        T location(const Vec<T> &phi, const Vec<T> &theta) const
+        {
+            return profile::robust_location(model, phi, theta);
         }
 
         template <typename T>
@@ -43,12 +67,12 @@ namespace robarma::ftau
 
             // Fix the estimate of sigma as the centered time series
             Vec<T> y_centered = model.y.template cast<T>().array() - T(base::median(model.y));
-            T sigma = robarma::tau::s<T>(y_centered);
+            T sigma = robarma::tau::s<T, Pair>(y_centered);
 
             Vec<T> z = Vec<T>::Zero(r);
             z.head(1).setOnes();
 
-            Mat<T> F = F0(phi);
+            Vec<T> f0 = phi0(phi);
             Vec<T> H = H0(theta);
             Mat<T> P = robust_autocov_matrix<T>(model.y.template cast<T>(), r, r);
 
@@ -61,7 +85,7 @@ namespace robarma::ftau
 
             for (int i = 1; i < model.n; i++)
             {
-                predict(a, P, F, H, sigma, c);
+                predict(a, P, f0, H, sigma, c);
                 mt = P.col(0);
                 s(i) = ceres::sqrt(mt(0));
                 u(i) = T(model.y(i)) - T(z.transpose() * a);
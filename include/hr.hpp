@@ -3,6 +3,7 @@
 #include <Eigen/Dense>
 #include <arma.hpp>
 #include <estimation_result.hpp>
+#include <ts.hpp>
 
 /**
  * @brief Initial estimators for estimating ARMA(p, q)-processes
@@ -14,48 +15,56 @@ namespace robarma::initial
      * @brief Hannan-Rissanen estimator
      * Fit an ARMA(p, q) process using Hannan-Rissanen estimator.
      * See \cite HannanRissanen
+     *
+     * The long autoregression is solved with Durbin-Levinson from the sample
+     * autocovariances and the second stage regression is formed directly from
+     * lagged cross-products, so no lagged design matrices are materialised.
      * @param model
      * @return arma_fit
      */
-    inline arma_fit hannan_rissanen(arma_model model)
+    inline arma_fit hannan_rissanen(const arma_model &model)
     {
-        // Step 1: Fit an AR(M)-model to data
+        // Step 1: Fit an AR(M)-model to data via Yule-Walker equations
         double mu = model.y.mean();
 
         int m = std::fmax(2 * model.p + 1, 2 * model.q + 1);
 
-        // Build special case of Toeplitz matrix
-        Eigen::MatrixXd ax = Eigen::MatrixXd::Zero(model.n - m, m);
-        for (int i = 0; i < m; i++)
+        Eigen::VectorXd x = model.y.array() - mu;
+        Eigen::VectorXd gamma = robarma::autocov<double>(x, m, 0.0);
+        Eigen::VectorXd ar = robarma::levinson_durbin<double>(gamma, m);
+
+        // Residuals of the long autoregression as a FIR filter over the series
+        Eigen::VectorXd yy = x.segment(m, model.n - m);
+        Eigen::VectorXd ee = yy;
+        for (int j = 0; j < m; j++)
         {
-            ax.col(i) << model.y.segment(m - i - 1, model.n - m).array() - mu;
+            ee -= ar(j) * x.segment(m - j - 1, model.n - m);
         }
 
-        Eigen::VectorXd yy = model.y.segment(m, model.n - m).array() - mu;
-        Eigen::VectorXd ar = ax.householderQr().solve(yy);
-
-        // Step 2: Fit a linear model
-        Eigen::VectorXd ee = yy - ax * ar;
-
+        // Step 2: Fit a linear model through its normal equations
         int rr = std::fmax(model.p + 1, model.q + 1);
         int t = ee.size();
+        int k = model.p + model.q;
 
-        Eigen::MatrixXd ay = Eigen::MatrixXd::Zero(t - rr, model.p);
-        for (int i = 0; i < model.p; i++)
+        // Column i of the (implicit) design matrix: lags of yy first, then lags of ee
+        auto column = [&](int i)
         {
-            ay.col(i) << yy.segment(rr - i - 1, t - rr);
-        }
+            return (i < model.p) ? yy.segment(rr - i - 1, t - rr) : ee.segment(rr - (i - model.p) - 1, t - rr);
+        };
 
-        Eigen::MatrixXd ae = Eigen::MatrixXd::Zero(t - rr, model.q);
-        for (int i = 0; i < model.q; i++)
+        Eigen::MatrixXd G(k, k);
+        Eigen::VectorXd b(k);
+        for (int i = 0; i < k; i++)
         {
-            ae.col(i) << ee.segment(rr - i - 1, t - rr);
+            for (int j = 0; j <= i; j++)
+            {
+                G(i, j) = column(i).dot(column(j));
+                G(j, i) = G(i, j);
+            }
+            b(i) = column(i).dot(yy.segment(rr, t - rr));
         }
 
-        Eigen::MatrixXd C(ay.rows(), ay.cols() + ae.cols());
-        C << ay, ae;
-
-        Eigen::VectorXd beta = C.householderQr().solve(yy.segment(rr, t - rr));
+        Eigen::VectorXd beta = G.ldlt().solve(b);
 
         Eigen::VectorXd phi = beta.segment(0, model.p);
         Eigen::VectorXd theta = beta.segment(model.p, model.q);
@@ -64,4 +73,23 @@ namespace robarma::initial
 
         return arma_fit(model, arma_params(phi, theta, mu), result);
     }
+
+    /**
+     * @brief Robust Yule-Walker estimator
+     *
+     * Robust autocovariances from robust scales of sums and differences of lagged
+     * pairs, turned into ARMA coefficients with Durbin-Levinson and the innovations
+     * algorithm. Used as a robust starting point.
+     * @param model
+     * @return arma_fit
+     */
+    inline arma_fit robust_yule_walker(const arma_model &model)
+    {
+        Eigen::VectorXd gamma = robarma::robust_autocov<double>(model.y, model.p + model.q, model.mu, model.sigma);
+        auto [phi, theta] = robarma::arma_from_autocov<double>(gamma, model.p, model.q);
+
+        estimation_result result = estimation_result(estimation_method::robust_yw, true, 0.0);
+
+        return arma_fit(model, arma_params(phi, theta, model.mu), result);
+    }
 } // namespace robarma::initial
@@ -0,0 +1,213 @@
+/**
+ * @file io.hpp
+ * @brief Binary column files for series panels and batch results.
+ *
+ * A file is a fixed header followed by a sequence of typed columns:
+ *
+ *     header:  magic "ROBARMA\0", uint32 byte-order mark 0x01020304, uint32 version,
+ *              uint32 kind, uint32 number of columns
+ *     column:  uint32 type tag, uint32 element size, uint64 element count, raw elements
+ *
+ * Columns are written as contiguous arrays in native byte order, so a reader on the same
+ * platform can map or read them without any per-element conversion; the byte-order mark
+ * rejects files from a platform of the other endianness. The meaning and order of the
+ * columns are fixed by the kind of the file.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ios>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace robarma::io
+{
+    enum class kind : std::uint32_t
+    {
+        panel = 1,
+        fits = 2
+    };
+
+    namespace detail
+    {
+        constexpr std::array<char, 8> magic{'R', 'O', 'B', 'A', 'R', 'M', 'A', '\0'};
+        constexpr std::uint32_t byte_order = 0x01020304u;
+        constexpr std::uint32_t version = 1;
+
+        template <typename T>
+        struct tag;
+
+        template <>
+        struct tag<double>
+        {
+            static constexpr std::uint32_t value = 1;
+        };
+
+        template <>
+        struct tag<std::int64_t>
+        {
+            static constexpr std::uint32_t value = 2;
+        };
+
+        template <>
+        struct tag<std::int32_t>
+        {
+            static constexpr std::uint32_t value = 3;
+        };
+
+        template <>
+        struct tag<std::uint8_t>
+        {
+            static constexpr std::uint32_t value = 4;
+        };
+
+        template <typename T>
+        void put(std::ostream &out, const T &value)
+        {
+            out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        template <typename T>
+        T get(std::istream &in)
+        {
+            T value;
+            if (!in.read(reinterpret_cast<char *>(&value), sizeof(T)))
+                throw std::runtime_error("Unexpected end of robarma column file.");
+            return value;
+        }
+
+        // Bytes left in a seekable stream, -1 if the stream cannot tell
+        inline std::streamoff available(std::istream &in)
+        {
+            std::streampos here = in.tellg();
+            if (here == std::streampos(-1))
+                return -1;
+            in.seekg(0, std::ios::end);
+            std::streampos end = in.tellg();
+            in.seekg(here);
+            if (end == std::streampos(-1) || !in)
+            {
+                in.clear();
+                in.seekg(here);
+                return -1;
+            }
+            return std::streamoff(end - here);
+        }
+    } // namespace detail
+
+    /**
+     * @brief Writes the header and then the columns of a file, in order.
+     */
+    class writer
+    {
+    public:
+        writer(std::ostream &out, kind type, int columns)
+            : out(out), remaining(columns)
+        {
+            out.write(detail::magic.data(), detail::magic.size());
+            detail::put(out, detail::byte_order);
+            detail::put(out, detail::version);
+            detail::put(out, static_cast<std::uint32_t>(type));
+            detail::put(out, static_cast<std::uint32_t>(columns));
+        }
+
+        template <typename T>
+        void column(const T *data, std::size_t count)
+        {
+            if (remaining-- <= 0)
+                throw std::invalid_argument("More columns written than declared in the header.");
+            detail::put(out, detail::tag<T>::value);
+            detail::put(out, static_cast<std::uint32_t>(sizeof(T)));
+            detail::put(out, static_cast<std::uint64_t>(count));
+            out.write(reinterpret_cast<const char *>(data), std::streamsize(count * sizeof(T)));
+            if (!out)
+                throw std::runtime_error("Failed to write robarma column file.");
+        }
+
+        template <typename T, typename Allocator>
+        void column(const std::vector<T, Allocator> &values)
+        {
+            column(values.data(), values.size());
+        }
+
+    private:
+        std::ostream &out;
+        int remaining;
+    };
+
+    /**
+     * @brief Checks the header of a file and reads its columns, in order.
+     */
+    class reader
+    {
+    public:
+        reader(std::istream &in, kind type)
+            : in(in)
+        {
+            std::array<char, 8> magic;
+            if (!in.read(magic.data(), magic.size()) || magic != detail::magic)
+                throw std::runtime_error("Not a robarma column file.");
+            if (detail::get<std::uint32_t>(in) != detail::byte_order)
+                throw std::runtime_error("robarma column file has a different byte order.");
+            std::uint32_t version = detail::get<std::uint32_t>(in);
+            if (version != detail::version)
+                throw std::runtime_error("Unsupported robarma column file version " + std::to_string(version) + ".");
+            if (detail::get<std::uint32_t>(in) != static_cast<std::uint32_t>(type))
+                throw std::runtime_error("robarma column file holds a different kind of data.");
+            remaining = int(detail::get<std::uint32_t>(in));
+        }
+
+        // Number of columns not yet read
+        int columns() const
+        {
+            return remaining;
+        }
+
+        template <typename T>
+        std::vector<T> column()
+        {
+            std::vector<T> values;
+            column(values);
+            return values;
+        }
+
+        template <typename T, typename Allocator>
+        void column(std::vector<T, Allocator> &values)
+        {
+            if (remaining-- <= 0)
+                throw std::runtime_error("robarma column file has fewer columns than expected.");
+            if (detail::get<std::uint32_t>(in) != detail::tag<T>::value || detail::get<std::uint32_t>(in) != sizeof(T))
+                throw std::runtime_error("robarma column file has a column of unexpected type.");
+            std::uint64_t count = detail::get<std::uint64_t>(in);
+
+            // Never allocate more than the file can hold: the count is checked against the
+            // bytes left in a seekable stream, and any other stream is read in chunks
+            std::streamoff left = detail::available(in);
+            if (left >= 0 && count > std::uint64_t(left) / sizeof(T))
+                throw std::runtime_error("robarma column file has a column longer than the file.");
+
+            constexpr std::uint64_t chunk = (std::uint64_t(1) << 20) / sizeof(T);
+            values.clear();
+            for (std::uint64_t done = 0; done < count;)
+            {
+                std::uint64_t step = left >= 0 ? count : std::min(count - done, chunk);
+                values.resize(done + step);
+                if (!in.read(reinterpret_cast<char *>(values.data() + done), std::streamsize(step * sizeof(T))))
+                    throw std::runtime_error("Unexpected end of robarma column file.");
+                done += step;
+            }
+        }
+
+    private:
+        std::istream &in;
+        int remaining;
+    };
+} // namespace robarma::io
+
+// end of file
@@ -0,0 +1,197 @@
+/**
+ * @file irls.hpp
+ * @brief Iteratively reweighted Gauss-Newton minimizer for the MM and BIP-MM objectives.
+ *
+ * Minimizes sum rho(e_t(beta) / sigma) over beta = (phi, theta, mu) for a fixed scale
+ * sigma, with rho from a family of rho.hpp (rho2 by default). Each iteration computes the
+ * residuals and their sensitivities J in one pass, forms the weights w_t = psi(u_t) / u_t
+ * with psi = rho' and u_t = e_t / sigma, and
+ * solves the (p + q + 1)-dimensional weighted normal system
+ *
+ *     (J' W J) delta = -J' W e
+ *
+ * followed by step halving until the objective decreases. For rho2, w_t = 1 for |u_t| <= 2
+ * and decreases to 0 at |u_t| = 3; as the weights of all families in rho.hpp are
+ * nonnegative, every step is a descent direction.
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <bip.hpp>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <string>
+
+namespace robarma::irls
+{
+    /**
+     * @brief Stopping rules, with the function and parameter tolerances of ceres::Solver::Options.
+     */
+    struct options
+    {
+        int max_iterations = 50;
+        int max_step_halvings = 20;
+        double function_tolerance = 1e-6;
+        double parameter_tolerance = 1e-8;
+    };
+
+    struct summary
+    {
+        bool convergence = false;
+        int iterations = 0;
+        int evaluations = 0;
+        double cost = 0.0;
+        const char *message = nullptr;
+
+        std::string report() const
+        {
+            std::ostringstream ss;
+            ss << "IRLS: " << message << ", iterations " << iterations << ", evaluations " << evaluations << ", cost " << cost;
+            return ss.str();
+        }
+    };
+
+    namespace detail
+    {
+        // psi(u) / u, with its limit psi'(0) at the origin
+        template <typename Rho>
+        double weight(double u)
+        {
+            return (u == 0.0) ? Rho::dpsi(0.0) : Rho::psi(u) / u;
+        }
+
+        // Observation weight of residual t, 1 when unweighted
+        inline double observation(const Eigen::VectorXd &weights, int t)
+        {
+            return (weights.size() == 0) ? 1.0 : weights(t);
+        }
+
+        template <typename Rho>
+        double objective(const Eigen::VectorXd &e, double sigma, const Eigen::VectorXd &weights)
+        {
+            double value = 0.0;
+            for (int t = 0; t < e.size(); t++)
+                value += observation(weights, t) * Rho::rho(e(t) / sigma);
+            return value;
+        }
+    } // namespace detail
+
+    /**
+     * @brief Minimize sum omega_t rho(e_t(beta) / sigma) with reweighted Gauss-Newton steps.
+     *
+     * @tparam Rho rho family, see rho.hpp
+     * @param residuals callable Eigen::VectorXd(const Eigen::VectorXd &beta, Eigen::MatrixXd &J)
+     *                  returning the residuals and writing their sensitivities to J
+     * @param sigma fixed scale
+     * @param beta initial parameters (phi, theta, mu), overwritten with the solution
+     * @param opts stopping rules
+     * @param weights observation weights omega_t, one per residual; empty for unit weights
+     * @return summary
+     */
+    template <typename Rho = robarma::bip::rho2_family, typename Residuals>
+    summary minimize(Residuals &&residuals, double sigma, Eigen::VectorXd &beta, const options &opts = {}, const Eigen::VectorXd &weights = Eigen::VectorXd())
+    {
+        summary result;
+
+        Eigen::MatrixXd J;
+        Eigen::VectorXd e = residuals(beta, J);
+        result.evaluations++;
+        double value = detail::objective<Rho>(e, sigma, weights);
+
+        if (!std::isfinite(value))
+        {
+            result.cost = value;
+            result.message = "non-finite initial cost";
+            return result;
+        }
+
+        if (beta.size() == 0)
+        {
+            result.convergence = true;
+            result.cost = value;
+            result.message = "no free parameters";
+            return result;
+        }
+
+        Eigen::MatrixXd J_trial;
+        Eigen::VectorXd w(e.size());
+
+        while (result.iterations < opts.max_iterations)
+        {
+            for (int t = 0; t < e.size(); t++)
+                w(t) = detail::observation(weights, t) * detail::weight<Rho>(e(t) / sigma);
+
+            Eigen::MatrixXd A = J.transpose() * w.asDiagonal() * J;
+            Eigen::VectorXd b = -J.transpose() * w.cwiseProduct(e);
+
+            // A small ridge keeps the system solvable when weights vanish on whole columns
+            A.diagonal().array() += std::numeric_limits<double>::epsilon() * std::fmax(A.diagonal().maxCoeff(), 1.0);
+            Eigen::VectorXd delta = A.ldlt().solve(b);
+
+            if (!delta.allFinite())
+            {
+                result.message = "singular normal equations";
+                break;
+            }
+
+            // Step halving until the objective decreases
+            double step = 1.0;
+            double trial_value = std::numeric_limits<double>::infinity();
+            Eigen::VectorXd trial;
+            Eigen::VectorXd e_trial;
+            for (int h = 0; h <= opts.max_step_halvings; h++, step /= 2.0)
+            {
+                trial = beta + step * delta;
+                e_trial = residuals(trial, J_trial);
+                result.evaluations++;
+                trial_value = detail::objective<Rho>(e_trial, sigma, weights);
+                if (trial_value < value)
+                    break;
+            }
+
+            result.iterations++;
+
+            if (!(trial_value < value))
+            {
+                // No decrease along the step: beta is optimal to working precision only if the
+                // Gauss-Newton model, with gradient -b / sigma^2, predicts no decrease either
+                double predicted = 0.5 * b.dot(delta) / (sigma * sigma);
+                result.convergence = predicted <= opts.function_tolerance * std::abs(value);
+                result.message = result.convergence ? "no further decrease" : "step halving failed";
+                break;
+            }
+
+            double decrease = value - trial_value;
+            double step_norm = step * delta.norm();
+            double beta_norm = beta.norm();
+
+            beta = trial;
+            e.swap(e_trial);
+            J.swap(J_trial);
+            value = trial_value;
+
+            if (decrease <= opts.function_tolerance * std::abs(value + decrease))
+            {
+                result.convergence = true;
+                result.message = "function tolerance reached";
+                break;
+            }
+            if (step_norm <= opts.parameter_tolerance * (beta_norm + opts.parameter_tolerance))
+            {
+                result.convergence = true;
+                result.message = "parameter tolerance reached";
+                break;
+            }
+        }
+
+        if (!result.message)
+            result.message = "maximum number of iterations reached";
+
+        result.cost = value;
+        return result;
+    }
+} // namespace robarma::irls
+
+// end of file
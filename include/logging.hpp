@@ -1,20 +1,47 @@
+/**
+ * @file logging.hpp
+ * @brief Ceres/glog logging controls.
+ *
+ * The library never initializes glog itself, so a host application that configures glog
+ * keeps its configuration. Every Ceres solve of the library runs with
+ * logging_type = ceres::SILENT, which stops the per-iteration solver output; glog itself
+ * is silenced only when the host calls disable_ceres_logging.
+ *
+ */
 #pragma once
+
+#include <ceres/ceres.h>
 #include <glog/logging.h>
+#include <mutex>
 
 namespace robarma
 {
-    // Helper to suppress Ceres/glog logging globally
+    /**
+     * @brief Initialize glog, unless the host already did, and drop all its output.
+     *
+     * Safe to call from several threads; only the first call has an effect.
+     *
+     * @param argv0 program name passed to google::InitGoogleLogging
+     */
     inline void disable_ceres_logging(const char *argv0 = "robarma")
     {
-#ifndef ROBARMA_ENABLE_CERES_LOGGING
-        static bool initialized = false;
-        if (!initialized)
-        {
-            google::InitGoogleLogging(argv0);
+        static std::once_flag once;
+        std::call_once(once, [argv0]()
+                       {
+            if (!google::IsGoogleLoggingInitialized())
+                google::InitGoogleLogging(argv0);
             FLAGS_minloglevel = 3;
-            FLAGS_logtostderr = 0;
-            initialized = true;
-        }
+            FLAGS_logtostderr = 0; });
+    }
+
+    // Solver options of the library's Ceres solves, silent unless ROBARMA_ENABLE_CERES_LOGGING
+    inline void silence_solver(ceres::Solver::Options &options)
+    {
+#ifndef ROBARMA_ENABLE_CERES_LOGGING
+        options.logging_type = ceres::SILENT;
+        options.minimizer_progress_to_stdout = false;
 #endif
     }
 } // namespace robarma
+
+// end of file
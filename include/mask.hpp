@@ -0,0 +1,141 @@
+/**
+ * @file mask.hpp
+ * @brief Fixed and masked ARMA parameters.
+ *
+ * A mask is given as a vector over beta = (phi, theta, mu), as the fixed argument of R's
+ * arima: NaN entries are estimated, all others are held at the given value. The masked cost
+ * functor takes the free parameters as a single packed block and expands them into the
+ * (phi, theta, mu) blocks of the wrapped functor, so fixed parameters take no slot in the
+ * Jet dimension.
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <alias.hpp>
+#include <arma.hpp>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace robarma::mask
+{
+    /**
+     * @brief Positions of the free parameters within beta = (phi, theta, mu).
+     *
+     *  - values: full parameter vector holding the fixed values
+     *  - free: indices of the estimated parameters in beta
+     */
+    struct layout
+    {
+        int p;
+        int q;
+        Eigen::VectorXd values;
+        std::vector<int> free;
+
+        /**
+         * @brief Build the layout of a model from a mask and the initial parameters.
+         *
+         * @param model
+         * @param fixed mask of length p + q + 1, NaN for estimated parameters
+         * @param initial initial parameters, used for the values of the free parameters
+         * @param computed_mu mu is computed by the functor (concentrated out) rather than estimated
+         */
+        layout(const arma_model &model, const Eigen::VectorXd &fixed, const arma_params &initial, bool computed_mu = false)
+            : p(model.p), q(model.q)
+        {
+            int k = p + q + 1;
+            if (fixed.size() != 0 && fixed.size() != k)
+                throw std::invalid_argument("Parameter mask must have length p + q + 1 = " + std::to_string(k) + ", got " + std::to_string(fixed.size()) + ".");
+
+            values.resize(k);
+            values << initial.phi, initial.theta, initial.mu;
+
+            for (int i = 0; i < k; i++)
+            {
+                if (fixed.size() != 0 && !std::isnan(fixed(i)))
+                    values(i) = fixed(i);
+                else if (!(computed_mu && i == k - 1))
+                    free.push_back(i);
+            }
+        }
+
+        int size() const
+        {
+            return free.size();
+        }
+
+        // Packed free parameters of params
+        Eigen::VectorXd pack(const arma_params &params) const
+        {
+            Eigen::VectorXd beta(p + q + 1);
+            beta << params.phi, params.theta, params.mu;
+
+            Eigen::VectorXd x(size());
+            for (int i = 0; i < size(); i++)
+                x(i) = beta(free[i]);
+            return x;
+        }
+
+        // Full parameter vector with the packed free parameters x
+        template <typename T>
+        Vec<T> expand(const T *x) const
+        {
+            Vec<T> beta = values.template cast<T>();
+            for (int i = 0; i < size(); i++)
+                beta(free[i]) = x[i];
+            return beta;
+        }
+
+        arma_params unpack(const double *x) const
+        {
+            Eigen::VectorXd beta = expand(x);
+            return arma_params(beta.segment(0, p), beta.segment(p, q), beta(p + q));
+        }
+    };
+
+    // True if the mask fixes at least one parameter
+    inline bool any_fixed(const Eigen::VectorXd &fixed)
+    {
+        return fixed.size() != 0 && !fixed.array().isNaN().all();
+    }
+
+    /**
+     * @brief Cost functor over the packed free parameters.
+     *
+     * @tparam Functor cost functor over the (phi, theta, mu) blocks
+     */
+    template <typename Functor>
+    struct cost
+    {
+    private:
+        std::unique_ptr<Functor> functor;
+        layout parameters_layout;
+
+    public:
+        cost(Functor *functor, const layout &parameters_layout)
+            : functor(functor), parameters_layout(parameters_layout)
+        {
+        }
+
+        template <typename T>
+        bool operator()(T const *const *parameters, T *residuals) const
+        {
+            int p = parameters_layout.p;
+            int q = parameters_layout.q;
+
+            Vec<T> beta = parameters_layout.expand(parameters[0]);
+            const T *blocks[] = {beta.data(), beta.data() + p, beta.data() + p + q};
+            return (*functor)(blocks, residuals);
+        }
+
+        const Functor &inner() const
+        {
+            return *functor;
+        }
+    };
+} // namespace robarma::mask
+
+// end of file
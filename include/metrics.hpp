@@ -0,0 +1,202 @@
+/**
+ * @file metrics.hpp
+ * @brief Pluggable sink for the library's solve metrics and diagnostics.
+ *
+ * Every top-level solve of an estimator reports one solve_event: the method, convergence,
+ * iterations, evaluations, number of attempts of the fallback ladder, series length and
+ * wall-clock time. Estimators built from several stages report one event per stage, e.g.
+ * MM reports its S stage and its MM stage. Fallback retries are reported as diagnostics.
+ *
+ * Events are delivered only when the library is compiled with ROBARMA_ENABLE_METRICS.
+ * Otherwise record, diagnostic and timer are empty inline functions and compile away, and
+ * an installed sink receives nothing.
+ *
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <estimation_result.hpp>
+
+namespace robarma::metrics
+{
+    struct solve_event
+    {
+        estimation_method method;
+        bool convergence;
+        int iterations;
+        int evaluations;
+        int attempts;
+        int n;
+        double seconds;
+    };
+
+    /**
+     * @brief Receiver of metrics and diagnostics; the default members ignore everything.
+     *
+     * Called from whichever thread runs the solve, so implementations must be thread-safe.
+     */
+    class sink
+    {
+    public:
+        virtual ~sink() = default;
+
+        virtual void solve(const solve_event &)
+        {
+        }
+
+        virtual void diagnostic(estimation_method, const char *)
+        {
+        }
+    };
+
+    namespace detail
+    {
+        inline std::atomic<sink *> &current()
+        {
+            static std::atomic<sink *> installed{nullptr};
+            return installed;
+        }
+    } // namespace detail
+
+    /**
+     * @brief Install the sink receiving all events, or remove it with nullptr.
+     *
+     * The sink must outlive every solve started while it is installed.
+     *
+     * @param s
+     */
+    inline void set_sink(sink *s)
+    {
+        detail::current().store(s, std::memory_order_release);
+    }
+
+#ifdef ROBARMA_ENABLE_METRICS
+    class timer
+    {
+    public:
+        double seconds() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+
+    inline void record(const solve_event &event)
+    {
+        if (sink *s = detail::current().load(std::memory_order_acquire))
+            s->solve(event);
+    }
+
+    inline void diagnostic(estimation_method method, const char *message)
+    {
+        if (sink *s = detail::current().load(std::memory_order_acquire))
+            s->diagnostic(method, message);
+    }
+#else
+    class timer
+    {
+    public:
+        double seconds() const
+        {
+            return 0.0;
+        }
+    };
+
+    inline void record(const solve_event &)
+    {
+    }
+
+    inline void diagnostic(estimation_method, const char *)
+    {
+    }
+#endif
+
+    /**
+     * @brief Sink counting solves and failures and keeping latency histograms, per method.
+     *
+     * Latency bucket b counts solves that took [2^b, 2^(b + 1)) microseconds; the first
+     * bucket also counts faster solves and the last one slower solves.
+     */
+    class counters : public sink
+    {
+    public:
+        static constexpr int buckets = 32;
+
+        void solve(const solve_event &event) override
+        {
+            entry &e = entries[index(event.method)];
+            e.solves.fetch_add(1, std::memory_order_relaxed);
+            if (!event.convergence)
+                e.failures.fetch_add(1, std::memory_order_relaxed);
+            e.evaluations.fetch_add(event.evaluations, std::memory_order_relaxed);
+            e.latency[bucket(event.seconds)].fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void diagnostic(estimation_method method, const char *) override
+        {
+            entries[index(method)].diagnostics.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        std::int64_t solves(estimation_method method) const
+        {
+            return entries[index(method)].solves.load(std::memory_order_relaxed);
+        }
+
+        std::int64_t failures(estimation_method method) const
+        {
+            return entries[index(method)].failures.load(std::memory_order_relaxed);
+        }
+
+        std::int64_t evaluations(estimation_method method) const
+        {
+            return entries[index(method)].evaluations.load(std::memory_order_relaxed);
+        }
+
+        std::int64_t diagnostics(estimation_method method) const
+        {
+            return entries[index(method)].diagnostics.load(std::memory_order_relaxed);
+        }
+
+        std::array<std::int64_t, buckets> latency(estimation_method method) const
+        {
+            std::array<std::int64_t, buckets> histogram;
+            for (int b = 0; b < buckets; b++)
+                histogram[b] = entries[index(method)].latency[b].load(std::memory_order_relaxed);
+            return histogram;
+        }
+
+        static int bucket(double seconds)
+        {
+            double microseconds = seconds * 1e6;
+            if (!(microseconds >= 2.0))
+                return 0;
+            int b = int(std::floor(std::log2(microseconds)));
+            return (b < buckets) ? b : buckets - 1;
+        }
+
+    private:
+        struct entry
+        {
+            std::atomic<std::int64_t> solves{0};
+            std::atomic<std::int64_t> failures{0};
+            std::atomic<std::int64_t> evaluations{0};
+            std::atomic<std::int64_t> diagnostics{0};
+            std::array<std::atomic<std::int64_t>, buckets> latency{};
+        };
+
+        std::array<entry, static_cast<std::size_t>(estimation_method::count)> entries;
+
+        static std::size_t index(estimation_method method)
+        {
+            return static_cast<std::size_t>(method);
+        }
+    };
+} // namespace robarma::metrics
+
+// end of file
@@ -1,70 +1,231 @@
 #pragma once
 
+#include <algorithm>
 #include <alias.hpp>
 #include <arma.hpp>
+#include <memory>
+#include <profile.hpp>
 #include <state_space_cost.hpp>
+#include <ts.hpp>
 
 namespace robarma::mle
 {
 
     struct cost : public robarma::state_space_cost
     {
+    private:
+        // Exact AR moments, set for pure AR models
+        std::shared_ptr<const ar_moments> ar;
+
     public:
         cost(arma_model model)
             : state_space_cost(model)
         {
+            if (model.q == 0 && model.p > 0 && !model.weighted())
+                ar = std::make_shared<const ar_moments>(lag_products(model.y, model.p).exact(model.p));
+        }
+
+        // Reuses lag products computed for the series, e.g. across AR orders up to products.max_lag
+        cost(arma_model model, const lag_products &products)
+            : state_space_cost(model)
+        {
+            if (model.q == 0 && model.p > 0 && !model.weighted())
+                ar = std::make_shared<const ar_moments>(products.exact(model.p));
         }
 
         template <typename T>
-        void predict(Vec<T> &a, Mat<T> &P, const Mat<T> F, const Vec<T> H, const Vec<T> c) const
+        void predict(Vec<T> &a, Mat<T> &P, const Vec<T> &phi, const Vec<T> &H, const Vec<T> &c) const
         {
-            a = F * a + c;
-            P = F * P * F.transpose() + H * H.transpose();
+            companion_predict(a, P, phi, H, T(1), c);
         }
 
         template <typename T>
         void update(Vec<T> &a, Mat<T> &P, const T v, const T f, const Vec<T> &z) const
         {
-            a = a + P * z * v / f;
-            T epsilon = std::numeric_limits<T>::epsilon();
-            P = P - (P * z * z.transpose() * P) / f;
+            // Rank-one downdate with the gain P z, without forming P z z' P
+            Vec<T> Pz = P * z;
+            a = a + Pz * v / f;
+            P = P - (Pz * Pz.transpose()) / f;
         }
 
         template <typename T>
         T loss(Vec<T> w, Vec<T> f) const
         {
-            T S = w.array().square().sum();
-            T log_likelihood = (T)model.n * log(S) + f.array().log().sum();
-            return log_likelihood;
+            if (!model.weighted())
+            {
+                T S = w.array().square().sum();
+                T log_likelihood = (T)model.n * log(S) + f.array().log().sum();
+                return log_likelihood;
+            }
+
+            // Weighted likelihood contributions
+            T S = T(0);
+            T log_f = T(0);
+            for (int t = 0; t < w.size(); t++)
+            {
+                S += model.weights(t) * w(t) * w(t);
+                log_f += model.weights(t) * log(f(t));
+            }
+            return (T)model.n * log(S) + log_f;
         }
 
+        /**
+         * @brief Exact likelihood of a pure AR(p) model from its cached moments.
+         *
+         * The quadratic form (y - mu)' V_n^-1 (y - mu) is beta' D(mu) beta, see
+         * lag_products::exact, and log |V_n| = log |V_p| = -sum_k k log(1 - kappa_k^2) with the
+         * partial autocorrelations kappa_k. Costs O(p^2) per evaluation, independent of n.
+         * Fails outside the stationarity region.
+         */
         template <typename T>
-        bool operator()(T const *const *parameters, T *residuals) const
+        bool ar_loss(const Vec<T> &phi, const T mu, T &loss) const
         {
-            auto [phi, theta, mu] = model.get_params(parameters);
+            bool stationary;
+            Vec<T> kappa = partial_autocorrelations(phi, &stationary);
+            if (!stationary)
+                return false;
+
+            T log_det = T(0);
+            for (int k = 1; k <= model.p; k++)
+                log_det -= T(k) * log(T(1) - kappa(k - 1) * kappa(k - 1));
+
+            loss = (T)model.n * log(ar->value(phi, mu)) + log_det;
+            return true;
+        }
+
+        /**
+         * @brief Exact innovations of a pure MA(q) model by a banded LDL' factorization.
+         *
+         * For p = 0 the covariance of y, in units of sigma^2, is banded Toeplitz with
+         * gamma_k = sum_j theta_j theta_{j+k} (theta_0 = 1) for k <= q. Its factorization
+         * Gamma = L D L', with L unit lower triangular of bandwidth q, costs O(n q^2), and
+         * v = L^-1 (y - mu) and f = D are the innovations and their variances. Only the last
+         * q + 1 rows of L are kept.
+         */
+        template <typename T>
+        void ma_filter(const Vec<T> &theta, const T mu, Vec<T> &w, Vec<T> &f) const
+        {
+            int q = model.q;
+            int n = model.n;
+
+            Vec<T> psi(q + 1);
+            psi(0) = T(1);
+            psi.tail(q) = theta;
+
+            Vec<T> gamma(q + 1);
+            for (int k = 0; k <= q; k++)
+                gamma(k) = psi.head(q + 1 - k).dot(psi.tail(q + 1 - k));
+
+            // L(t % (q + 1), a - 1) holds the entry of L at (t, t - a)
+            Mat<T> L = Mat<T>::Zero(q + 1, std::max(q, 1));
+            f = Vec<T>::Ones(n);
+            w = Vec<T>::Zero(n);
+            Vec<T> v = Vec<T>::Zero(n);
+
+            for (int t = 0; t < n; t++)
+            {
+                int row = t % (q + 1);
+                int band = std::min(t, q);
+
+                // Entries (t, t - m) by decreasing m, each using the ones further left
+                for (int m = band; m >= 1; m--)
+                {
+                    int j = t - m;
+                    T sum = gamma(m);
+                    for (int a = m + 1; a <= band; a++)
+                        sum -= L(row, a - 1) * L(j % (q + 1), a - m - 1) * f(t - a);
+                    L(row, m - 1) = sum / f(j);
+                }
+
+                T d = gamma(0);
+                T u = T(model.y(t)) - mu;
+                for (int a = 1; a <= band; a++)
+                {
+                    d -= L(row, a - 1) * L(row, a - 1) * f(t - a);
+                    u -= L(row, a - 1) * v(t - a);
+                }
+                f(t) = d;
+                v(t) = u;
+                w(t) = u / ceres::sqrt(d);
+            }
+        }
+
+        /**
+         * @brief Filter pass returning standardized innovations w and their variances f.
+         *
+         * Kalman filter in general, the exact banded factorization of ma_filter for p = 0.
+         */
+        template <typename T>
+        void filter(const Vec<T> &phi, const Vec<T> &theta, const T mu, Vec<T> &w, Vec<T> &f) const
+        {
+            if (model.p == 0)
+            {
+                ma_filter(theta, mu, w, f);
+                return;
+            }
 
             Vec<T> z = Vec<T>::Zero(r);
             z.head(1).setOnes();
 
-            Mat<T> F = F0(phi);
+            Vec<T> f0 = phi0(phi);
             Vec<T> H = H0(theta);
             Mat<T> P = autocov_matrix<T>(model.y.template cast<T>(), r, r);
 
-            Vec<T> f = Vec<T>::Ones(model.n);
+            f = Vec<T>::Ones(model.n);
+            w = Vec<T>::Zero(model.n);
             Vec<T> v = Vec<T>::Zero(model.n);
-            Vec<T> w = Vec<T>::Zero(model.n);
 
             Vec<T> a = Vec<T>::Zero(r);
             Vec<T> c = c0(phi, mu);
 
             for (size_t i = 0; i < model.n; i++)
             {
-                predict(a, P, F, H, c);
+                predict(a, P, f0, H, c);
                 f(i) = T(z.transpose() * P * z);
                 v(i) = T(model.y(i)) - T(z.transpose() * a);
                 w(i) = v(i) / ceres::sqrt(f(i));
                 update(a, P, v(i), f(i), z);
             }
+        }
+
+        /**
+         * @brief GLS location profiling mu out of the likelihood.
+         *
+         * The innovation variances do not depend on mu and the innovations are affine in it,
+         * so the likelihood is maximized by the least squares fit of w(mu) = w(0) + mu * d.
+         * Computed in double precision: as the exact minimizer, its derivative does not enter
+         * the gradient of the profile likelihood.
+         */
+        template <typename T>
+        T location(const Vec<T> &phi, const Vec<T> &theta) const
+        {
+            if (ar)
+                return T(ar->location<double>(profile::value(phi)));
+
+            Eigen::VectorXd phi0 = profile::value(phi);
+            Eigen::VectorXd theta0 = profile::value(theta);
+
+            Eigen::VectorXd w0, w1, f;
+            filter<double>(phi0, theta0, 0.0, w0, f);
+            filter<double>(phi0, theta0, 1.0, w1, f);
+
+            Eigen::VectorXd d = w1 - w0;
+            if (model.weighted())
+                w0.array() *= model.weights.array();
+            double dd = model.weighted() ? d.dot(model.weights.cwiseProduct(d)) : d.squaredNorm();
+            return T((dd > 0.0) ? -w0.dot(d) / dd : model.mu);
+        }
+
+        template <typename T>
+        bool operator()(T const *const *parameters, T *residuals) const
+        {
+            auto [phi, theta, mu] = model.get_params(parameters);
+
+            if (ar)
+                return ar_loss(phi, mu, residuals[0]);
+
+            Vec<T> w, f;
+            filter(phi, theta, mu, w, f);
             residuals[0] = loss(w, f);
             return true;
         };
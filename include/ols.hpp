@@ -3,26 +3,74 @@
 #include <Eigen/Dense>
 #include <alias.hpp>
 #include <arma.hpp>
+#include <memory>
+#include <profile.hpp>
 #include <solver.hpp>
+#include <ts.hpp>
 
 namespace robarma::ols
 {
+    /**
+     * @brief Sum of squared ARMA residuals.
+     *
+     * For pure AR models the objective depends on the data only through the lagged
+     * cross-products of y, so their (p + 1) x (p + 1) moments are computed once and each
+     * evaluation costs O(p^2) instead of a pass over the series. Observation weights
+     * disable the cache, as the weighted moments would have to be rebuilt per weighting.
+     */
     struct cost
     {
     private:
         arma_model model;
+        std::shared_ptr<const ar_moments> ar;
 
     public:
         cost(arma_model model)
-            : model(model) {}
+            : model(model)
+        {
+            if (model.q == 0 && model.p > 0 && !model.weighted())
+                ar = std::make_shared<const ar_moments>(lag_products(model.y, model.p).conditional(model.p));
+        }
+
+        // Reuses lag products computed for the series, e.g. across AR orders up to products.max_lag
+        cost(arma_model model, const lag_products &products)
+            : model(model)
+        {
+            if (model.q == 0 && model.p > 0 && !model.weighted())
+                ar = std::make_shared<const ar_moments>(products.conditional(model.p));
+        }
+
+        // GLS location used when mu is concentrated out, see arma_model::gls_location
+        template <typename T>
+        T location(const Vec<T> &phi, const Vec<T> &theta) const
+        {
+            if (ar)
+                return T(ar->location<double>(profile::value(phi)));
+            return T(model.gls_location(profile::value(phi), profile::value(theta)));
+        }
 
         template <typename T>
         bool operator()(T const *const *parameters, T *residuals) const
         {
             auto [phi, theta, mu] = model.get_params(parameters);
 
+            if (ar)
+            {
+                residuals[0] = ar->value(phi, mu);
+                return true;
+            }
+
             Vec<T> e = model.arma_residuals(phi, theta, mu);
-            residuals[0] = e.array().square().sum();
+            if (!model.weighted())
+            {
+                residuals[0] = e.array().square().sum();
+                return true;
+            }
+
+            T est = T(0);
+            for (int t = 0; t < e.size(); t++)
+                est += model.weights(t) * e(t) * e(t);
+            residuals[0] = est;
             return true;
         };
     };
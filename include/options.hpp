@@ -0,0 +1,172 @@
+/**
+ * @file options.hpp
+ * @brief Options shared by the Ceres-based estimators.
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <estimation_result.hpp>
+#include <vector>
+
+namespace robarma
+{
+    /**
+     * @brief Coarse-to-fine schedule for long series.
+     *
+     * When enabled, the estimator is first fitted on contiguous subsamples of growing
+     * length, taken from the end of the series, and each stage is warm-started from the
+     * previous one. The final stage refines on the full series.
+     *
+     *  - sizes: explicit subsample lengths in increasing order; if empty, a geometric
+     *    schedule min_size, min_size * growth, ... below n is used
+     */
+    struct coarse_to_fine_options
+    {
+        bool enabled = false;
+        std::vector<int> sizes;
+        int min_size = 10000;
+        double growth = 10.0;
+
+        // Subsample lengths for a series of length n, excluding the full series
+        std::vector<int> schedule(int n) const
+        {
+            std::vector<int> stages;
+            if (!enabled)
+                return stages;
+
+            if (!sizes.empty())
+            {
+                for (int size : sizes)
+                    if (size < n && (stages.empty() || size > stages.back()))
+                        stages.push_back(size);
+                return stages;
+            }
+
+            for (double size = min_size; size < n; size *= growth)
+                stages.push_back(static_cast<int>(size));
+            return stages;
+        }
+    };
+
+    /**
+     * @brief Optimizer used by solver::solve.
+     *
+     *  - ceres: ceres::Problem with a dynamic autodiff cost function
+     *  - bfgs: in-library dense BFGS without heap allocations, for short series where
+     *    solver overhead dominates the O(n) objective pass
+     */
+    enum class solver_backend
+    {
+        ceres,
+        bfgs
+    };
+
+    /**
+     * @brief Retry applied by the fallback ladder after a non-converged solve.
+     *
+     *  - robust_start: restart from the robust Yule-Walker estimate
+     *  - line_search_direction: Ceres line search with the other quasi-Newton direction
+     *    (BFGS instead of LBFGS and vice versa), from the best point so far
+     *  - trust_region: Ceres trust-region (Levenberg-Marquardt) on the scalar cost,
+     *    from the best point so far. It can stop at its start, which then does not count.
+     */
+    enum class fallback_step
+    {
+        robust_start,
+        line_search_direction,
+        trust_region
+    };
+
+    inline const char *to_string(fallback_step step)
+    {
+        switch (step)
+        {
+        case fallback_step::robust_start:
+            return "robust start";
+        case fallback_step::line_search_direction:
+            return "line search direction";
+        case fallback_step::trust_region:
+            return "trust region";
+        }
+        return "unknown";
+    }
+
+    /**
+     * @brief Fallback ladder for non-converged fits.
+     *
+     * Retries run in ladder order until one converges or the evaluation budget is spent.
+     * A retry replaces the best fit so far only if it lowers the cost, and the best fit is
+     * returned.
+     *
+     *  - enabled: run the ladder. Off by default, so a non-converged solve is returned as
+     *    is; enabling it can change the parameters of such fits and costs up to
+     *    max_evaluations evaluations per fit.
+     *  - max_iterations: iteration limit of each retry
+     *  - max_evaluations: evaluation budget of the whole ladder, the first solve included.
+     *    Each retry's iterations and line search trials are capped by the remaining budget.
+     */
+    struct fallback_options
+    {
+        bool enabled = false;
+        std::vector<fallback_step> ladder = {fallback_step::robust_start, fallback_step::line_search_direction, fallback_step::trust_region};
+        int max_iterations = 100;
+        int max_evaluations = 1000;
+    };
+
+    /**
+     * @brief Options accepted by every Ceres-based estimator.
+     *
+     *  - coarse_to_fine: subsample schedule for warm-starting long series
+     *  - backend: optimizer used for each solve
+     *  - irls: refine MM and BIP-MM with the IRLS Gauss-Newton engine, falling back to
+     *    backend (and coarse_to_fine) only when it does not converge
+     *  - concentrate_mu: profile mu out of the autodiff backends, computing it from phi and
+     *    theta in each evaluation (GLS for OLS and MLE, a robust location step otherwise).
+     *    MM and BIP-MM then skip IRLS and solve with backend directly.
+     *  - fixed: parameter mask over (phi, theta, mu) as in R's arima; NaN entries are
+     *    estimated, all others held at the given value. Empty estimates all parameters.
+     *  - fallback: retries after a non-converged solve
+     *  - start: warm start over (phi, theta, mu), e.g. a previous fit of the same series,
+     *    replacing the initial estimate as the starting point of the solve. Empty starts
+     *    from the initial estimator.
+     *  - report: fill estimation_result::report for native BFGS solves, which otherwise skip
+     *    building it; Ceres solves always carry their report
+     *  - keep_residuals: cache the one-step residuals on the fit (arma_fit::residuals) for
+     *    diagnostics and filtering, which otherwise recompute them; the residual quantile
+     *    sketch is filled either way. Batch and column fits turn it off.
+     */
+    struct estimation_options
+    {
+        coarse_to_fine_options coarse_to_fine;
+        solver_backend backend = solver_backend::ceres;
+        bool irls = true;
+        bool concentrate_mu = false;
+        Eigen::VectorXd fixed;
+        fallback_options fallback;
+        Eigen::VectorXd start;
+        bool report = false;
+        bool keep_residuals = true;
+    };
+
+    /**
+     * @brief Estimator selection of estimators::auto_fit.
+     *
+     * The series is screened as contaminated when the classical-to-robust scale ratio of
+     * the Hannan-Rissanen residuals exceeds scale_ratio, or when more than flagged_fraction
+     * of them lie beyond cutoff robust scales (0.27% at cutoff 3 for Gaussian innovations).
+     *
+     *  - classical: estimator for clean series, OLS or MLE
+     *  - robust: estimator for contaminated series, MM or BIP-MM
+     */
+    struct selection_options
+    {
+        double scale_ratio = 1.2;
+        double flagged_fraction = 0.01;
+        double cutoff = 3.0;
+        estimation_method classical = estimation_method::mle;
+        estimation_method robust = estimation_method::bmm;
+    };
+} // namespace robarma
+
+// end of file
@@ -0,0 +1,226 @@
+/**
+ * @file panel.hpp
+ * @brief Contiguous panel of time series in a structure-of-arrays layout.
+ *
+ * All values live in one buffer; series i occupies length(i) values starting at offset(i).
+ * With lanes > 1 every series starts at a multiple of lanes values and is zero padded up to
+ * the next one, so that each series begins on a SIMD-aligned boundary of the buffer. The
+ * robust location (median) and scale (M-scale of base::scale) of every series are computed
+ * once when it is added and kept in arrays beside the offsets, so the models made from the
+ * panel do not recompute them.
+ *
+ * Panels are stored in the column files of io.hpp, with the columns
+ *
+ *     lanes, offsets, lengths, locations, scales, values
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <arma.hpp>
+#include <ceres/ceres.h>
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <io.hpp>
+#include <istream>
+#include <ostream>
+#include <robust.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace robarma
+{
+    class series_panel
+    {
+    public:
+        /**
+         * @brief Empty panel.
+         *
+         * @param lanes alignment of the series starts, in values
+         */
+        explicit series_panel(int lanes = 1)
+            : width(lanes), offsets{0}
+        {
+            if (lanes < 1)
+                throw std::invalid_argument("Panel lanes must be positive, got " + std::to_string(lanes) + ".");
+        }
+
+        /**
+         * @brief Reserve storage for a number of series of a total length.
+         *
+         * @param series
+         * @param values total number of values, without padding
+         */
+        void reserve(int series, std::int64_t values)
+        {
+            buffer.reserve(values + std::int64_t(series) * (width - 1));
+            offsets.reserve(series + 1);
+            lengths.reserve(series);
+            locations.reserve(series);
+            scales.reserve(series);
+        }
+
+        /**
+         * @brief Append a series, computing its robust location and scale.
+         *
+         * @param y
+         */
+        void push_back(const Eigen::Ref<const Eigen::VectorXd> &y)
+        {
+            if (y.size() == 0)
+                throw std::invalid_argument("Panel series must not be empty.");
+            double mu = robarma::base::median(y);
+            double sigma = robarma::base::scale<double>(y.array() - mu);
+            push_back(y, mu, sigma);
+        }
+
+        /**
+         * @brief Append a series with a known robust location and scale.
+         *
+         * @param y
+         * @param location
+         * @param scale
+         */
+        void push_back(const Eigen::Ref<const Eigen::VectorXd> &y, double location, double scale)
+        {
+            if (y.size() == 0)
+                throw std::invalid_argument("Panel series must not be empty.");
+
+            buffer.insert(buffer.end(), y.data(), y.data() + y.size());
+            std::int64_t padded = (std::int64_t(buffer.size()) + width - 1) / width * width;
+            buffer.resize(padded, 0.0);
+
+            offsets.push_back(padded);
+            lengths.push_back(y.size());
+            locations.push_back(location);
+            scales.push_back(scale);
+        }
+
+        // Number of series
+        int size() const
+        {
+            return int(lengths.size());
+        }
+
+        int lanes() const
+        {
+            return width;
+        }
+
+        int length(int i) const
+        {
+            return int(lengths[i]);
+        }
+
+        std::int64_t offset(int i) const
+        {
+            return offsets[i];
+        }
+
+        double location(int i) const
+        {
+            return locations[i];
+        }
+
+        double scale(int i) const
+        {
+            return scales[i];
+        }
+
+        // The value buffer, including padding
+        const double *data() const
+        {
+            return buffer.data();
+        }
+
+        Eigen::Map<const Eigen::VectorXd> series(int i) const
+        {
+            return Eigen::Map<const Eigen::VectorXd>(buffer.data() + offsets[i], lengths[i]);
+        }
+
+        /**
+         * @brief ARMA(p, q) model of series i with the precomputed location and scale.
+         *
+         * The model is a view of the panel's buffer, which must outlive it.
+         *
+         * @param i
+         * @param p
+         * @param q
+         * @return arma_model
+         */
+        arma_model model(int i, int p, int q) const
+        {
+            return arma_model::view(series(i), p, q, locations[i], scales[i]);
+        }
+
+        void write(std::ostream &out) const
+        {
+            io::writer file(out, io::kind::panel, 6);
+            std::int64_t lanes = width;
+            file.column(&lanes, 1);
+            file.column(offsets);
+            file.column(lengths);
+            file.column(locations);
+            file.column(scales);
+            file.column(buffer);
+        }
+
+        static series_panel read(std::istream &in)
+        {
+            io::reader file(in, io::kind::panel);
+            std::vector<std::int64_t> header = file.column<std::int64_t>();
+            if (header.size() != 1 || header[0] < 1 || header[0] > INT_MAX)
+                throw std::runtime_error("Panel file has invalid lanes.");
+
+            series_panel panel{int(header[0])};
+            file.column(panel.offsets);
+            file.column(panel.lengths);
+            file.column(panel.locations);
+            file.column(panel.scales);
+            file.column(panel.buffer);
+
+            std::size_t m = panel.lengths.size();
+            if (m > std::size_t(INT_MAX) || panel.offsets.size() != m + 1 || panel.locations.size() != m || panel.scales.size() != m || panel.offsets[0] != 0 || panel.offsets.back() != std::int64_t(panel.buffer.size()))
+                throw std::runtime_error("Panel file has inconsistent columns.");
+            for (std::size_t i = 0; i < m; i++)
+            {
+                if (panel.lengths[i] < 1 || panel.lengths[i] > INT_MAX)
+                    throw std::runtime_error("Panel file has a series of invalid length " + std::to_string(panel.lengths[i]) + ".");
+                if (panel.offsets[i] % panel.width != 0)
+                    throw std::runtime_error("Panel file has a series not aligned to its lanes.");
+                // Offsets are nonnegative and increasing here, so the sum cannot overflow
+                if (panel.offsets[i + 1] < panel.offsets[i] || panel.lengths[i] > panel.offsets[i + 1] - panel.offsets[i])
+                    throw std::runtime_error("Panel file has overlapping series.");
+            }
+            return panel;
+        }
+
+        void save(const std::string &path) const
+        {
+            std::ofstream out(path, std::ios::binary);
+            if (!out)
+                throw std::runtime_error("Cannot open " + path + " for writing.");
+            write(out);
+        }
+
+        static series_panel load(const std::string &path)
+        {
+            std::ifstream in(path, std::ios::binary);
+            if (!in)
+                throw std::runtime_error("Cannot open " + path + " for reading.");
+            return read(in);
+        }
+
+    private:
+        int width;
+        std::vector<double, Eigen::aligned_allocator<double>> buffer;
+        std::vector<std::int64_t> offsets;
+        std::vector<std::int64_t> lengths;
+        std::vector<double> locations;
+        std::vector<double> scales;
+    };
+} // namespace robarma
+
+// end of file
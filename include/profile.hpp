@@ -0,0 +1,146 @@
+/**
+ * @file profile.hpp
+ * @brief Concentrating the location mu out of the ARMA cost functions.
+ *
+ * The wrapped functor only sees phi and theta as free parameters. Before each evaluation
+ * the location is computed from them by the functor's own location rule,
+ *
+ *     template <typename T> T location(const Vec<T> &phi, const Vec<T> &theta) const;
+ *
+ * and passed on as the third parameter block. The mu block of the problem is held constant,
+ * so it takes no slot in the Jet dimension.
+ *
+ *  - OLS and MLE: analytic GLS location, the exact minimizer of the objective in mu
+ *  - robust estimators: Huber location of the residuals, see robust_location
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <alias.hpp>
+#include <arma.hpp>
+#include <ceres/ceres.h>
+#include <robust.hpp>
+#include <utility>
+
+namespace robarma::profile
+{
+    // Value part of a scalar, dropping any derivative
+    inline double value(double x)
+    {
+        return x;
+    }
+
+    template <typename T, int N>
+    double value(const ceres::Jet<T, N> &x)
+    {
+        return x.a;
+    }
+
+    template <typename T>
+    Eigen::VectorXd value(const Vec<T> &x)
+    {
+        Eigen::VectorXd v(x.size());
+        for (int i = 0; i < x.size(); i++)
+            v(i) = value(x(i));
+        return v;
+    }
+
+    /**
+     * @brief Robust location for given ARMA coefficients.
+     *
+     * The residuals respond to a shift of mu by the long-run gain (1 - sum phi) / (1 + sum theta).
+     * Starting from the sample median of the series, a fixed number of Huber W-steps on the residuals, with
+     * their MADN as scale, gives a location that is robust yet smooth in phi and theta, so
+     * that its derivatives can be propagated through the Jets. Observation weights multiply
+     * the Huber weights, and zero-weight residuals are left out of the MADN.
+     *
+     * @param model
+     * @param phi
+     * @param theta
+     * @param steps number of W-steps
+     * @return T
+     */
+    template <typename T>
+    T robust_location(const arma_model &model, const Vec<T> &phi, const Vec<T> &theta, int steps = 5)
+    {
+        T gain = (T(1) - phi.sum()) / (T(1) + theta.sum());
+        if (!(ceres::abs(gain) > T(1e-8)))
+            return T(model.mu);
+
+        int m = model.n - model.r;
+        Vec<T> e = model.arma_residuals(phi, theta, T(model.mu)).tail(m);
+
+        // Observations with zero weight take no part in the scale either
+        T s;
+        if (model.weighted())
+        {
+            Vec<T> kept(m);
+            int count = 0;
+            for (int t = 0; t < m; t++)
+                if (model.weights(model.r + t) > 0.0)
+                    kept(count++) = e(t);
+            s = robarma::base::MADN(Vec<T>(kept.head(count)));
+        }
+        else
+            s = robarma::base::MADN(e);
+        if (!(s > T(0)))
+            return T(model.mu);
+
+        T k = T(1.345);
+        T shift = T(0);
+        for (int step = 0; step < steps; step++)
+        {
+            T numerator = T(0);
+            T denominator = T(0);
+            for (int t = 0; t < m; t++)
+            {
+                T u = ceres::abs(e(t) - shift) / s;
+                T w = T(model.weight(model.r + t)) * ((u <= k) ? T(1) : k / u);
+                numerator += w * e(t);
+                denominator += w;
+            }
+            shift = numerator / denominator;
+        }
+        return T(model.mu) + shift / gain;
+    }
+
+    /**
+     * @brief Cost functor with mu concentrated out by the location rule of Functor.
+     *
+     * @tparam Functor cost functor providing location(phi, theta)
+     */
+    template <typename Functor>
+    struct cost
+    {
+    private:
+        Functor functor;
+        int p;
+        int q;
+
+    public:
+        cost(Functor functor, const arma_model &model)
+            : functor(std::move(functor)), p(model.p), q(model.q)
+        {
+        }
+
+        template <typename T>
+        bool operator()(T const *const *parameters, T *residuals) const
+        {
+            Vec<T> phi = Eigen::Map<const Vec<T>>(parameters[0], p);
+            Vec<T> theta = Eigen::Map<const Vec<T>>(parameters[1], q);
+            T mu = functor.location(phi, theta);
+
+            const T *blocks[] = {parameters[0], parameters[1], &mu};
+            return functor(blocks, residuals);
+        }
+
+        // Concentrated location at the given coefficients
+        double location(const arma_params &params) const
+        {
+            return functor.template location<double>(params.phi, params.theta);
+        }
+    };
+} // namespace robarma::profile
+
+// end of file
@@ -0,0 +1,359 @@
+/**
+ * @file rho.hpp
+ * @brief rho/psi families as policy types with compile-time tuning constants.
+ *
+ * Each family provides, for any scalar type T (double or ceres::Jet),
+ *
+ *  - rho(x), psi(x) = rho'(x) and dpsi(x) = rho''(x)
+ *  - max_rho: supremum of rho, infinite for unbounded families
+ *  - delta: right-hand side of the M-scale equation mean(rho(x / s)) = delta,
+ *    chosen as max_rho / 2 for bounded families
+ *  - breakpoint: breakdown point of that M-scale, min(delta, max_rho - delta) / max_rho
+ *  - efficiency(): Gaussian efficiency (E psi')^2 / E psi^2 of the M-estimator of
+ *    regression at unit scale, evaluated at compile time
+ *
+ * Tuning constants are given as std::ratio, so every constant folds into the kernels.
+ *
+ *  - optimal: the polynomial rho of \cite Muler, rho(x) = rho_0(x / c) with
+ *    breakpoints 2c and 3c; c = 1 is rho2 and c = 0.405 is rho1 of bip.hpp
+ *  - bisquare: Tukey bisquare normalized to max_rho = 1
+ *  - huber: Huber rho, unbounded and therefore without an M-scale
+ *  - tau_pair: the rho1/rho2 pair and filter psi of the tau-estimator of \cite Bianco
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <alias.hpp>
+#include <ceres/ceres.h>
+#include <limits>
+#include <ratio>
+#include <robust.hpp>
+
+namespace robarma::rho
+{
+    namespace detail
+    {
+        template <typename R>
+        constexpr double value()
+        {
+            return double(R::num) / double(R::den);
+        }
+
+        template <typename T>
+        constexpr T abs(const T x)
+        {
+            return (x < T(0)) ? -x : x;
+        }
+
+        // exp for x <= 0, by argument halving and a Taylor series
+        constexpr double exp(double x)
+        {
+            int halvings = 0;
+            while (x < -0.5)
+            {
+                x /= 2.0;
+                halvings++;
+            }
+
+            double term = 1.0;
+            double sum = 1.0;
+            for (int i = 1; i < 20; i++)
+            {
+                term *= x / i;
+                sum += term;
+            }
+
+            for (int i = 0; i < halvings; i++)
+                sum *= sum;
+            return sum;
+        }
+
+        // (E psi')^2 / E psi^2 under N(0, 1), Simpson's rule on [-8, 8]
+        template <typename Family>
+        constexpr double gaussian_efficiency()
+        {
+            constexpr int intervals = 1600;
+            constexpr double h = 16.0 / intervals;
+
+            double dpsi = 0.0;
+            double psi2 = 0.0;
+            for (int i = 0; i <= intervals; i++)
+            {
+                double x = -8.0 + i * h;
+                double weight = (i == 0 || i == intervals) ? 1.0 : ((i % 2) ? 4.0 : 2.0);
+                double density = 0.3989422804014327 * exp(-x * x / 2.0);
+                double psi = Family::psi(x);
+
+                dpsi += weight * density * Family::dpsi(x);
+                psi2 += weight * density * psi * psi;
+            }
+            return (h / 3.0) * dpsi * dpsi / psi2;
+        }
+    } // namespace detail
+
+    /**
+     * @brief Optimal rho of \cite Muler, scaled by c.
+     *
+     * @tparam C tuning constant c
+     */
+    template <typename C = std::ratio<1>>
+    struct optimal
+    {
+        static constexpr double c = detail::value<C>();
+        static constexpr double max_rho = 3.25;
+        static constexpr double delta = max_rho / 2;
+        static constexpr double breakpoint = delta / max_rho;
+
+        template <typename T>
+        static constexpr T rho(const T x)
+        {
+            T u = x / T(c);
+            T a = detail::abs(u);
+            if (a <= T(2))
+                return T(0.5) * u * u;
+            if (a <= T(3))
+            {
+                T u2 = u * u;
+                return ((((T(0.002) * u2 - T(0.052)) * u2 + T(0.432)) * u2 - T(0.972)) * u2) + T(1.792);
+            }
+            return T(max_rho);
+        }
+
+        template <typename T>
+        static constexpr T psi(const T x)
+        {
+            T u = x / T(c);
+            T a = detail::abs(u);
+            if (a <= T(2))
+                return u / T(c);
+            if (a <= T(3))
+            {
+                T u2 = u * u;
+                return (((T(0.016) * u2 - T(0.312)) * u2 + T(1.728)) * u2 - T(1.944)) * u / T(c);
+            }
+            return T(0);
+        }
+
+        template <typename T>
+        static constexpr T dpsi(const T x)
+        {
+            T u = x / T(c);
+            T a = detail::abs(u);
+            if (a <= T(2))
+                return T(1) / T(c * c);
+            if (a <= T(3))
+            {
+                T u2 = u * u;
+                return (((T(0.112) * u2 - T(1.56)) * u2 + T(5.184)) * u2 - T(1.944)) / T(c * c);
+            }
+            return T(0);
+        }
+
+        static constexpr double efficiency()
+        {
+            return detail::gaussian_efficiency<optimal>();
+        }
+    };
+
+    /**
+     * @brief Tukey bisquare, rho(x) = 1 - (1 - (x / k)^2)^3 for |x| <= k.
+     *
+     * The default k = 1.547645 gives a 50% breakdown M-scale.
+     *
+     * @tparam K tuning constant k
+     */
+    template <typename K = std::ratio<1547645, 1000000>>
+    struct bisquare
+    {
+        static constexpr double k = detail::value<K>();
+        static constexpr double max_rho = 1.0;
+        static constexpr double delta = max_rho / 2;
+        static constexpr double breakpoint = delta / max_rho;
+
+        template <typename T>
+        static constexpr T rho(const T x)
+        {
+            T u = x / T(k);
+            if (detail::abs(u) > T(1))
+                return T(1);
+            T v = T(1) - u * u;
+            return T(1) - v * v * v;
+        }
+
+        template <typename T>
+        static constexpr T psi(const T x)
+        {
+            T u = x / T(k);
+            if (detail::abs(u) > T(1))
+                return T(0);
+            T v = T(1) - u * u;
+            return T(6) * u * v * v / T(k);
+        }
+
+        template <typename T>
+        static constexpr T dpsi(const T x)
+        {
+            T u = x / T(k);
+            if (detail::abs(u) > T(1))
+                return T(0);
+            T u2 = u * u;
+            return T(6) * (T(1) - u2) * (T(1) - T(5) * u2) / T(k * k);
+        }
+
+        static constexpr double efficiency()
+        {
+            return detail::gaussian_efficiency<bisquare>();
+        }
+    };
+
+    /**
+     * @brief Huber rho. Unbounded, so it has no delta and cannot define an M-scale.
+     *
+     * @tparam K tuning constant k
+     */
+    template <typename K = std::ratio<1345, 1000>>
+    struct huber
+    {
+        static constexpr double k = detail::value<K>();
+        static constexpr double max_rho = std::numeric_limits<double>::infinity();
+        static constexpr double breakpoint = 0.0;
+
+        template <typename T>
+        static constexpr T rho(const T x)
+        {
+            T a = detail::abs(x);
+            if (a <= T(k))
+                return T(0.5) * x * x;
+            return T(k) * a - T(0.5 * k * k);
+        }
+
+        template <typename T>
+        static constexpr T psi(const T x)
+        {
+            if (x > T(k))
+                return T(k);
+            if (x < T(-k))
+                return T(-k);
+            return x;
+        }
+
+        template <typename T>
+        static constexpr T dpsi(const T x)
+        {
+            return (detail::abs(x) <= T(k)) ? T(1) : T(0);
+        }
+
+        static constexpr double efficiency()
+        {
+            return detail::gaussian_efficiency<huber>();
+        }
+    };
+
+    /**
+     * @brief rho-functions of the tau-estimator of \cite Bianco.
+     *
+     *  - first: bisquare rho1 of the M-scale, cut off at c1
+     *  - second: rho2 of the tau-scale, cut off at c2
+     *  - filter: Huber psi of the robust filter, clipping at c1
+     *
+     * @tparam C1 tuning constant c1
+     * @tparam C2 tuning constant c2
+     */
+    template <typename C1 = std::ratio<155, 100>, typename C2 = std::ratio<28, 10>>
+    struct tau_pair
+    {
+        using first = bisquare<C1>;
+        using filter = huber<C1>;
+
+        struct second
+        {
+            static constexpr double c = detail::value<C2>();
+
+            // Polynomial given for c2 = 2.8 and rescaled for other cut-offs
+            template <typename T>
+            static constexpr T rho(const T x)
+            {
+                T u = x * T(2.8 / c);
+                if (detail::abs(u) > T(2.8))
+                    return T(1);
+                T u2 = u * u;
+                return ((T(-0.0018) * u2 + T(0.012)) * u2 + T(0.14)) * u2;
+            }
+        };
+
+        static constexpr double breakpoint = first::breakpoint;
+    };
+
+    /**
+     * @brief M-scale of centered x with the rho of Family, solving mean(rho(x / s)) = delta.
+     *
+     * Same fixed-point iteration as base::scale, started from MADN, but with rho called
+     * directly so that it is inlined.
+     *
+     * @tparam Family bounded rho family
+     * @param x
+     * @return T
+     */
+    template <typename Family, typename T>
+    T scale(const Vec<T> &x)
+    {
+        T tol = T(1e-6);
+        T err = T(1) + tol;
+        int max = 100;
+        int i = 0;
+
+        T sigma_0 = robarma::base::median(x.array().abs()) / T(0.6745);
+        T sigma_1;
+
+        while ((err > tol) && (i < max))
+        {
+            i = i + 1;
+            T sum = T(0);
+            for (int t = 0; t < x.size(); t++)
+                sum += Family::rho(x(t) / sigma_0);
+            sigma_1 = ceres::sqrt(sigma_0 * sigma_0 * (sum / T(x.size())) / T(Family::delta));
+            err = ceres::abs(sigma_1 - sigma_0) / sigma_0;
+            sigma_0 = sigma_1;
+        }
+        return sigma_0;
+    }
+
+    /**
+     * @brief Weighted M-scale, solving sum(w rho(x / s)) / sum(w) = delta.
+     *
+     * @tparam Family bounded rho family
+     * @param x
+     * @param w observation weights of the same length as x; empty for the unweighted scale
+     * @return T
+     */
+    template <typename Family, typename T>
+    T scale(const Vec<T> &x, const Eigen::VectorXd &w)
+    {
+        if (w.size() == 0)
+            return scale<Family>(x);
+
+        T tol = T(1e-6);
+        T err = T(1) + tol;
+        int max = 100;
+        int i = 0;
+
+        T sigma_0 = robarma::base::median(x.array().abs()) / T(0.6745);
+        T sigma_1;
+        double total = w.sum();
+
+        while ((err > tol) && (i < max))
+        {
+            i = i + 1;
+            T sum = T(0);
+            for (int t = 0; t < x.size(); t++)
+                sum += w(t) * Family::rho(x(t) / sigma_0);
+            sigma_1 = ceres::sqrt(sigma_0 * sigma_0 * (sum / T(total)) / T(Family::delta));
+            err = ceres::abs(sigma_1 - sigma_0) / sigma_0;
+            sigma_0 = sigma_1;
+        }
+        return sigma_0;
+    }
+} // namespace robarma::rho
+
+// end of file
@@ -0,0 +1,149 @@
+/**
+ * @file robarma.h
+ * @brief C API of the robarma_c library, for foreign-function interfaces.
+ *
+ * Series are read from caller-owned double buffers and results are written into
+ * caller-owned output buffers, so bindings pass their arrays through without
+ * conversions or intermediate containers. A panel of m series lies in one buffer: series i
+ * holds lengths[i] values starting at values + offsets[i], which is the layout of
+ * series_panel. The models are views of the caller's buffer, so no series is copied;
+ * estimators allocate only their own working vectors, such as residuals.
+ *
+ * All functions return a robarma_status; on failure, robarma_last_error gives a message
+ * for the calling thread. Structs carry their size in their first member so that fields can
+ * be appended in later versions without breaking the ABI: a struct of an earlier, smaller
+ * version is accepted and the fields it lacks take their defaults, and the fields of a
+ * later, larger version beyond the known ones are ignored.
+ *
+ */
+#ifndef ROBARMA_H
+#define ROBARMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(ROBARMA_C_API_BUILD)
+#define ROBARMA_API __declspec(dllexport)
+#else
+#define ROBARMA_API __declspec(dllimport)
+#endif
+#else
+#define ROBARMA_API __attribute__((visibility("default")))
+#endif
+
+#define ROBARMA_C_API_VERSION 1
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /* Same values as robarma::estimation_method */
+    typedef enum robarma_method
+    {
+        ROBARMA_HANNAN_RISSANEN = 0,
+        ROBARMA_OLS = 1,
+        ROBARMA_MLE = 2,
+        ROBARMA_FTAU = 3,
+        ROBARMA_S = 4,
+        ROBARMA_BIP_S = 5,
+        ROBARMA_MM = 6,
+        ROBARMA_BIP_MM = 7,
+        ROBARMA_ROBUST_YW = 8
+    } robarma_method;
+
+    typedef enum robarma_status
+    {
+        ROBARMA_OK = 0,
+        /* Invalid buffers, options, model order, or a series too short for the model */
+        ROBARMA_INVALID_ARGUMENT = 1,
+        /* Some series could not be fitted; their outputs are NaN and not converged */
+        ROBARMA_FIT_FAILED = 2,
+        ROBARMA_ERROR = 3
+    } robarma_status;
+
+    /**
+     * @brief Estimation controls, initialized by robarma_default_options.
+     *
+     *  - size: sizeof(robarma_options), set by robarma_default_options
+     *  - method: estimator, a robarma_method value (stored as int32_t for a fixed layout)
+     *  - threads: worker threads for panels, all hardware threads for threads <= 0
+     *  - irls: nonzero to refine MM and BIP-MM with IRLS
+     *  - concentrate_mu: nonzero to profile mu out of the objective
+     *  - fallback: nonzero to retry non-converged solves along the fallback ladder (off by default)
+     *  - bfgs: nonzero for the native BFGS optimizer instead of Ceres
+     */
+    typedef struct robarma_options
+    {
+        size_t size;
+        int32_t method;
+        int threads;
+        int irls;
+        int concentrate_mu;
+        int fallback;
+        int bfgs;
+    } robarma_options;
+
+    /**
+     * @brief Caller-owned output columns for m fits of an ARMA(p, q) model.
+     *
+     * Coefficients are column-major with one row per series: phi[j * m + i] is phi_{j + 1}
+     * of series i. Any pointer may be NULL to skip that output.
+     *
+     *  - size: sizeof(robarma_fits)
+     *  - phi: m * p values
+     *  - theta: m * q values
+     *  - mu, cost, seconds: m values
+     *  - convergence, iterations: m values
+     */
+    typedef struct robarma_fits
+    {
+        size_t size;
+        double *phi;
+        double *theta;
+        double *mu;
+        double *cost;
+        uint8_t *convergence;
+        int32_t *iterations;
+        double *seconds;
+    } robarma_fits;
+
+    ROBARMA_API int robarma_api_version(void);
+
+    ROBARMA_API void robarma_default_options(robarma_options *options);
+
+    /**
+     * @brief Fit an ARMA(p, q) model to one series.
+     *
+     * @param y n values
+     * @param n
+     * @param p
+     * @param q
+     * @param options NULL for the defaults
+     * @param out columns for m = 1 fit
+     */
+    ROBARMA_API robarma_status robarma_fit(const double *y, int64_t n, int p, int q, const robarma_options *options, const robarma_fits *out);
+
+    /**
+     * @brief Fit an ARMA(p, q) model to every series of a panel, in parallel.
+     *
+     * @param values buffer of all series
+     * @param offsets m start offsets into values
+     * @param lengths m series lengths
+     * @param m number of series
+     * @param p
+     * @param q
+     * @param options NULL for the defaults
+     * @param out columns for m fits
+     */
+    ROBARMA_API robarma_status robarma_fit_panel(const double *values, const int64_t *offsets, const int64_t *lengths, int64_t m, int p, int q, const robarma_options *options, const robarma_fits *out);
+
+    /* Message of the last failure on the calling thread, empty if none */
+    ROBARMA_API const char *robarma_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ROBARMA_H */
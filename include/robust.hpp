@@ -1,16 +1,22 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <alias.hpp>
 
 namespace robarma::base
 {
+    // Median by selection, reorders d in place
     template <typename Derived>
     inline typename Derived::Scalar median(Eigen::DenseBase<Derived> &d)
     {
+        using Scalar = typename Derived::Scalar;
         auto r{d.reshaped()};
-        std::sort(r.begin(), r.end());
-        return r.size() % 2 == 0 ? r.segment((r.size() - 2) / 2, 2).mean() : r(r.size() / 2);
+        auto mid = r.begin() + r.size() / 2;
+        std::nth_element(r.begin(), mid, r.end());
+        if (r.size() % 2 == 1)
+            return *mid;
+        return (*std::max_element(r.begin(), mid) + *mid) / Scalar(2);
     }
 
     template <typename Derived>
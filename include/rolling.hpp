@@ -0,0 +1,404 @@
+/**
+ * @file rolling.hpp
+ * @brief Sliding-window robust statistics: rolling median, MADN and M-scale.
+ *
+ * The window keeps its values in an order-statistic tree, a treap whose nodes carry their
+ * subtree sizes, and the values in arrival order in a ring buffer. Appending a value,
+ * evicting the oldest one and selecting the k-th smallest value cost O(log w) expected for
+ * a window of length w, independent of the length of the series, so values can be streamed
+ * in one at a time with order_statistics::push. The MAD is the median distance to the
+ * median; it is selected from the two sorted sides of the median (values below it read
+ * downwards, values above it upwards) by bisection, in O(log^2 w) per step.
+ *
+ * The rolling M-scale solves the same fixed-point equation as base::scale with the bisquare
+ * rho of robust.hpp, each window warm-started from the scale of the previous one, so that
+ * a step typically takes one or two passes over the window.
+ *
+ * For a window length w, entry i of each result belongs to the window y(i), ..., y(i + w - 1).
+ *
+ */
+#pragma once
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <alias.hpp>
+#include <ceres/ceres.h>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <robust.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace robarma::rolling
+{
+    /**
+     * @brief Order statistics of a sliding window of at most w values.
+     */
+    class order_statistics
+    {
+    public:
+        explicit order_statistics(int w)
+            : capacity(w)
+        {
+            if (w < 1)
+                throw std::invalid_argument("Window length must be positive, got " + std::to_string(w) + ".");
+            ring.resize(w);
+            nodes.reserve(w);
+        }
+
+        /**
+         * @brief Append a value, evicting the oldest one once the window holds w values.
+         *
+         * @param x
+         */
+        void push(double x)
+        {
+            if (std::isnan(x))
+                throw std::invalid_argument("Rolling statistics are undefined for NaN values.");
+            if (count == capacity)
+                root = erase(root, ring[next]);
+            else
+                count++;
+            ring[next] = x;
+            next = (next + 1) % capacity;
+            root = insert(root, allocate(x));
+        }
+
+        int size() const
+        {
+            return count;
+        }
+
+        // Whether the window holds w values
+        bool full() const
+        {
+            return count == capacity;
+        }
+
+        // k-th smallest value in the window, k = 0, ..., size() - 1
+        double select(int k) const
+        {
+            int t = root;
+            while (true)
+            {
+                int left = size(nodes[t].left);
+                if (k < left)
+                    t = nodes[t].left;
+                else if (k == left)
+                    return nodes[t].key;
+                else
+                {
+                    k -= left + 1;
+                    t = nodes[t].right;
+                }
+            }
+        }
+
+        double median() const
+        {
+            int m = count / 2;
+            if (count % 2 == 1)
+                return select(m);
+            return (select(m - 1) + select(m)) / 2.0;
+        }
+
+        // Median absolute deviation from the median
+        double mad() const
+        {
+            double center = median();
+            int m = count / 2;
+            if (count % 2 == 1)
+                return deviation(center, m);
+            return (deviation(center, m - 1) + deviation(center, m)) / 2.0;
+        }
+
+    private:
+        struct node
+        {
+            double key;
+            std::uint32_t priority;
+            int left;
+            int right;
+            int size;
+        };
+
+        int capacity;
+        int count = 0;
+        int next = 0;
+        int root = -1;
+        std::uint32_t seed = 2463534242u;
+        std::vector<double> ring;
+        std::vector<node> nodes;
+        std::vector<int> unused;
+
+        int size(int t) const
+        {
+            return t < 0 ? 0 : nodes[t].size;
+        }
+
+        void pull(int t)
+        {
+            nodes[t].size = 1 + size(nodes[t].left) + size(nodes[t].right);
+        }
+
+        // New node from the free list, so the pool never grows past w nodes
+        int allocate(double x)
+        {
+            // xorshift32 priorities keep the treap balanced in expectation
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            node fresh{x, seed, -1, -1, 1};
+            if (!unused.empty())
+            {
+                int t = unused.back();
+                unused.pop_back();
+                nodes[t] = fresh;
+                return t;
+            }
+            nodes.push_back(fresh);
+            return int(nodes.size()) - 1;
+        }
+
+        // Split t into keys below key and keys at or above it
+        void split(int t, double key, int &below, int &above)
+        {
+            if (t < 0)
+            {
+                below = above = -1;
+                return;
+            }
+            if (nodes[t].key < key)
+            {
+                split(nodes[t].right, key, nodes[t].right, above);
+                below = t;
+            }
+            else
+            {
+                split(nodes[t].left, key, below, nodes[t].left);
+                above = t;
+            }
+            pull(t);
+        }
+
+        // Merge a and b, all keys of a at or below those of b
+        int merge(int a, int b)
+        {
+            if (a < 0 || b < 0)
+                return a < 0 ? b : a;
+            if (nodes[a].priority > nodes[b].priority)
+            {
+                nodes[a].right = merge(nodes[a].right, b);
+                pull(a);
+                return a;
+            }
+            nodes[b].left = merge(a, nodes[b].left);
+            pull(b);
+            return b;
+        }
+
+        int insert(int t, int k)
+        {
+            if (t < 0)
+                return k;
+            if (nodes[k].priority > nodes[t].priority)
+            {
+                split(t, nodes[k].key, nodes[k].left, nodes[k].right);
+                pull(k);
+                return k;
+            }
+            if (nodes[k].key < nodes[t].key)
+                nodes[t].left = insert(nodes[t].left, k);
+            else
+                nodes[t].right = insert(nodes[t].right, k);
+            pull(t);
+            return t;
+        }
+
+        // Remove one value equal to x, which is in the window
+        int erase(int t, double x)
+        {
+            if (nodes[t].key == x)
+            {
+                unused.push_back(t);
+                return merge(nodes[t].left, nodes[t].right);
+            }
+            if (x < nodes[t].key)
+                nodes[t].left = erase(nodes[t].left, x);
+            else
+                nodes[t].right = erase(nodes[t].right, x);
+            pull(t);
+            return t;
+        }
+
+        // Number of window values strictly below x
+        int below(double x) const
+        {
+            int result = 0;
+            for (int t = root; t >= 0;)
+            {
+                if (nodes[t].key < x)
+                {
+                    result += size(nodes[t].left) + 1;
+                    t = nodes[t].right;
+                }
+                else
+                    t = nodes[t].left;
+            }
+            return result;
+        }
+
+        /**
+         * @brief k-th smallest |y - center| in the window.
+         *
+         * The deviations of the values below center, read downwards, and of the others,
+         * read upwards, form two sorted sequences; the k-th smallest of their union is found
+         * by bisection on the number a taken from the lower one.
+         */
+        double deviation(double center, int k) const
+        {
+            int split = below(center);
+            int na = split;
+            int nb = count - split;
+
+            auto lower = [&](int i)
+            { return center - select(split - 1 - i); };
+            auto upper = [&](int i)
+            { return select(split + i) - center; };
+
+            int need = k + 1;
+            int lo = std::max(0, need - nb);
+            int hi = std::min(need, na);
+            while (lo < hi)
+            {
+                int a = (lo + hi) / 2;
+                int b = need - a;
+                // Too few taken from the lower sequence if its next value beats the last upper one
+                if (b > 0 && a < na && lower(a) < upper(b - 1))
+                    lo = a + 1;
+                else
+                    hi = a;
+            }
+
+            int a = lo;
+            int b = need - a;
+            double value = -std::numeric_limits<double>::infinity();
+            if (a > 0)
+                value = std::max(value, lower(a - 1));
+            if (b > 0)
+                value = std::max(value, upper(b - 1));
+            return value;
+        }
+    };
+
+    namespace detail
+    {
+        inline void check_window(const Eigen::VectorXd &y, int w)
+        {
+            if (w < 1 || w > y.size())
+                throw std::invalid_argument("Window length must lie in [1, " + std::to_string(y.size()) + "], got " + std::to_string(w) + ".");
+        }
+
+        // Calls f(i, window) for the window y(i), ..., y(i + w - 1)
+        template <typename F>
+        void slide(const Eigen::VectorXd &y, int w, F f)
+        {
+            check_window(y, w);
+            order_statistics window(w);
+            for (int t = 0; t < y.size(); t++)
+            {
+                window.push(y(t));
+                if (window.full())
+                    f(t - w + 1, window);
+            }
+        }
+    } // namespace detail
+
+    /**
+     * @brief Rolling median.
+     *
+     * @param y
+     * @param w window length
+     * @return Eigen::VectorXd of length n - w + 1
+     */
+    inline Eigen::VectorXd median(const Eigen::VectorXd &y, int w)
+    {
+        detail::check_window(y, w);
+        Eigen::VectorXd result(y.size() - w + 1);
+        detail::slide(y, w, [&](int i, const order_statistics &window)
+                      { result(i) = window.median(); });
+        return result;
+    }
+
+    /**
+     * @brief Rolling normalized MAD, as base::MADN.
+     *
+     * @param y
+     * @param w window length
+     * @return Eigen::VectorXd of length n - w + 1
+     */
+    inline Eigen::VectorXd MADN(const Eigen::VectorXd &y, int w)
+    {
+        detail::check_window(y, w);
+        Eigen::VectorXd result(y.size() - w + 1);
+        detail::slide(y, w, [&](int i, const order_statistics &window)
+                      { result(i) = window.mad() / 0.675; });
+        return result;
+    }
+
+    /**
+     * @brief Rolling M-scale of the window centered at its median.
+     *
+     * Solves mean(rho(x / s)) = b with the bisquare rho of base::scale. Each window starts
+     * from the scale of the previous one when it lies within a factor of two of the
+     * window's MADN, and from the MADN otherwise. Windows with zero MAD have scale zero.
+     *
+     * @param y
+     * @param w window length
+     * @param b right-hand side of the M-scale equation
+     * @param k bisquare tuning constant
+     * @return Eigen::VectorXd of length n - w + 1
+     */
+    inline Eigen::VectorXd scale(const Eigen::VectorXd &y, int w, double b = 0.5, double k = 1.547645)
+    {
+        detail::check_window(y, w);
+        const double tol = 1e-6;
+        const int max = 100;
+
+        Eigen::VectorXd result(y.size() - w + 1);
+        double sigma = 0.0;
+
+        detail::slide(y, w, [&](int i, const order_statistics &window)
+                      {
+            double center = window.median();
+            auto x = y.segment(i, w).array() - center;
+
+            double start = window.mad() / 0.6745;
+            if (!(start > 0.0))
+            {
+                result(i) = sigma = 0.0;
+                return;
+            }
+
+            // Warm start unless the window changed too much: from far below, the iteration
+            // only grows by a factor of at most sqrt(1 / b) per pass
+            double sigma_0 = (sigma > 0.5 * start && sigma < 2.0 * start) ? sigma : start;
+
+            double err = 1.0 + tol;
+            for (int it = 0; err > tol && it < max; it++)
+            {
+                double sum = 0.0;
+                for (int t = 0; t < w; t++)
+                    sum += robarma::base::bisquare(x(t) / sigma_0, k);
+                double sigma_1 = std::sqrt(sigma_0 * sigma_0 * (sum / w) / b);
+                err = std::abs(sigma_1 - sigma_0) / sigma_0;
+                sigma_0 = sigma_1;
+            }
+            result(i) = sigma = sigma_0; });
+        return result;
+    }
+} // namespace robarma::rolling
+
+// end of file
@@ -4,10 +4,18 @@
 #include <alias.hpp>
 #include <arma.hpp>
 #include <bip.hpp>
+#include <profile.hpp>
+#include <rho.hpp>
 #include <robust.hpp>
 
 namespace robarma::s
 {
+    /**
+     * @brief M-scale of the ARMA residuals.
+     *
+     * @tparam Rho bounded rho family of the M-scale, see rho.hpp
+     */
+    template <typename Rho = robarma::bip::rho1_family>
     struct cost
     {
     private:
@@ -19,15 +27,19 @@ namespace robarma::s
         {
         }
 
+        // Robust location step used when mu is concentrated out
+        template <typename T>
+        T location(const Vec<T> &phi, const Vec<T> &theta) const
+        {
+            return profile::robust_location(model, phi, theta);
+        }
+
         template <typename T>
         bool operator()(T const *const *parameters, T *residuals) const
         {
             auto [phi, theta, mu] = model.get_params(parameters);
-            // Set delta as delta = max rho1 / 2
-            // Max of rho1 = 3.25
-            T delta = T(3.25 / 2);
-            std::function<Vec<T>(Vec<T>)> func = static_cast<Vec<T> (*)(const Vec<T>)>(&robarma::bip::rho1);
-            T est = robarma::base::scale(model.arma_residuals(phi, theta, mu), delta, func);
+            // delta = max rho / 2, given by the family
+            T est = robarma::rho::scale<Rho>(model.arma_residuals(phi, theta, mu), model.weights);
             residuals[0] = est;
             return true;
         };
@@ -9,6 +9,7 @@
 #include <Eigen/Dense>
 #include <algorithm>
 #include <ctime>
+#include <panel.hpp>
 #include <random>
 #include <unsupported/Eigen/Polynomials>
 
@@ -171,6 +172,35 @@ namespace robarma
         }
         return x.tail(n);
     }
+
+    /**
+     * @brief Simulate m independent series of one ARMA(p, q) process into a panel
+     *
+     * Series i is simulated with seed + i.
+     *
+     * @param phi AR parameters
+     * @param theta MA parameters
+     * @param mu location parameter
+     * @param n length of every series
+     * @param m number of series
+     * @param burn_in size of burn in period (default: 100)
+     * @param seed random seed (default: 0, uses current time)
+     * @param lanes alignment of the series in the panel (default: 1)
+     * @return series_panel
+     */
+    inline series_panel
+    simulate_panel(const Eigen::VectorXd &phi, const Eigen::VectorXd &theta, double mu,
+                   int n, int m, int burn_in = 100, int seed = 0, int lanes = 1)
+    {
+        if (seed == 0)
+            seed = static_cast<int>(std::time(nullptr));
+
+        series_panel panel(lanes);
+        panel.reserve(m, std::int64_t(n) * m);
+        for (int i = 0; i < m; i++)
+            panel.push_back(simulate(phi, theta, mu, n, Eigen::VectorXd{}, burn_in, seed + i));
+        return panel;
+    }
 } // namespace robarma
 
 // end of file
\ No newline at end of file
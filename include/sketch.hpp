@@ -0,0 +1,196 @@
+/**
+ * @file sketch.hpp
+ * @brief Mergeable streaming quantile sketch.
+ *
+ * KLL sketch of \cite Karnin: a stack of compactors where level h holds items of weight 2^h.
+ * When the sketch exceeds its capacity, the lowest full level is sorted and every other item,
+ * starting at a random offset, is promoted to the next level. Level capacities decrease
+ * geometrically by 2/3 from the top, so the memory stays O(k) items plus a logarithmic
+ * number of levels, and the rank error is O(1 / k) with high probability. Two sketches
+ * merge by concatenating their levels and compacting.
+ *
+ */
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace robarma::sketch
+{
+    class kll
+    {
+    public:
+        /**
+         * @brief Empty sketch.
+         *
+         * @param k accuracy parameter, capacity of the top compactor
+         */
+        explicit kll(int k = 200)
+            : k(k)
+        {
+            if (k < 8)
+                throw std::invalid_argument("KLL accuracy parameter k must be at least 8.");
+        }
+
+        void insert(double x)
+        {
+            if (levels.empty())
+                grow();
+            levels[0].push_back(x);
+            n++;
+            items++;
+            while (items > capacity)
+                compress();
+        }
+
+        void merge(const kll &other)
+        {
+            while (levels.size() < other.levels.size())
+                grow();
+            for (std::size_t h = 0; h < other.levels.size(); h++)
+                levels[h].insert(levels[h].end(), other.levels[h].begin(), other.levels[h].end());
+            n += other.n;
+            items += other.items;
+            while (items > capacity)
+                compress();
+        }
+
+        // Number of values inserted, including those of merged sketches
+        std::int64_t count() const
+        {
+            return n;
+        }
+
+        // Number of values retained
+        std::int64_t retained() const
+        {
+            return items;
+        }
+
+        /**
+         * @brief Approximate q-quantile of the inserted values.
+         *
+         * @param q probability in [0, 1]
+         * @return double, NaN for an empty sketch
+         */
+        double quantile(double q) const
+        {
+            if (n == 0)
+                return std::numeric_limits<double>::quiet_NaN();
+
+            std::vector<std::pair<double, std::int64_t>> weighted = sorted();
+            double target = std::clamp(q, 0.0, 1.0) * double(n);
+            std::int64_t cumulative = 0;
+            for (const auto &[value, weight] : weighted)
+            {
+                cumulative += weight;
+                if (double(cumulative) >= target)
+                    return value;
+            }
+            return weighted.back().first;
+        }
+
+        /**
+         * @brief Approximate fraction of the inserted values not exceeding x.
+         *
+         * @param x
+         * @return double
+         */
+        double rank(double x) const
+        {
+            if (n == 0)
+                return std::numeric_limits<double>::quiet_NaN();
+
+            std::int64_t below = 0;
+            for (std::size_t h = 0; h < levels.size(); h++)
+                for (double value : levels[h])
+                    if (value <= x)
+                        below += std::int64_t(1) << h;
+            return double(below) / double(n);
+        }
+
+    private:
+        int k;
+        std::int64_t n = 0;
+        std::int64_t items = 0;
+        std::int64_t capacity = 0;
+        std::vector<std::vector<double>> levels;
+        std::uint64_t state = 0x9E3779B97F4A7C15ull;
+
+        int level_capacity(std::size_t h) const
+        {
+            int depth = int(levels.size() - 1 - h);
+            return std::max(2, int(std::ceil(k * std::pow(2.0 / 3.0, depth))));
+        }
+
+        void grow()
+        {
+            levels.emplace_back();
+            capacity = 0;
+            for (std::size_t h = 0; h < levels.size(); h++)
+                capacity += level_capacity(h);
+        }
+
+        // xorshift64, enough to randomize the compaction offsets
+        bool coin()
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state & 1;
+        }
+
+        // Compacts the lowest level at or above its capacity into the next level
+        void compress()
+        {
+            for (std::size_t h = 0; h < levels.size(); h++)
+            {
+                if (int(levels[h].size()) < level_capacity(h))
+                    continue;
+
+                if (h + 1 == levels.size())
+                    grow();
+
+                std::vector<double> &level = levels[h];
+                std::sort(level.begin(), level.end());
+
+                // An odd item out stays at this level
+                double kept = 0.0;
+                bool odd = level.size() % 2 == 1;
+                if (odd)
+                {
+                    kept = level.back();
+                    level.pop_back();
+                }
+
+                std::size_t offset = coin() ? 1 : 0;
+                for (std::size_t i = offset; i < level.size(); i += 2)
+                    levels[h + 1].push_back(level[i]);
+
+                items -= std::int64_t(level.size() / 2);
+                level.clear();
+                if (odd)
+                    level.push_back(kept);
+                return;
+            }
+        }
+
+        std::vector<std::pair<double, std::int64_t>> sorted() const
+        {
+            std::vector<std::pair<double, std::int64_t>> weighted;
+            weighted.reserve(items);
+            for (std::size_t h = 0; h < levels.size(); h++)
+                for (double value : levels[h])
+                    weighted.emplace_back(value, std::int64_t(1) << h);
+            std::sort(weighted.begin(), weighted.end());
+            return weighted;
+        }
+    };
+} // namespace robarma::sketch
+
+// end of file
@@ -1,9 +1,24 @@
 #pragma once
 
+#include <algorithm>
 #include <arma.hpp>
+#include <bfgs.hpp>
+#include <cmath>
 #include <estimation_result.hpp>
+#include <hr.hpp>
+#include <irls.hpp>
 
 #include <logging.hpp>
+#include <mask.hpp>
+#include <metrics.hpp>
+#include <optional>
+#include <options.hpp>
+#include <profile.hpp>
+#include <sketch.hpp>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
 
 namespace robarma::solver
 {
@@ -25,6 +40,49 @@ namespace robarma::solver
         return {phi_ptr, theta_ptr, mu_ptr};
     }
 
+    namespace detail
+    {
+        // Whether a cost functor has its own residual recursion, Eigen::VectorXd residuals(const arma_params &)
+        template <typename Functor, typename = void>
+        struct has_residuals : std::false_type
+        {
+        };
+
+        template <typename Functor>
+        struct has_residuals<Functor, std::void_t<decltype(std::declval<const Functor &>().residuals(std::declval<const arma_params &>()))>> : std::true_type
+        {
+        };
+    } // namespace detail
+
+    /**
+     * @brief Final residual pass of a fit.
+     *
+     * Computes the one-step residuals at the fitted parameters with the recursion of the
+     * cost functor, its residuals member if it has one and the ARMA recursion otherwise, and
+     * fills the quantile sketch of the residuals past the burn-in r in the same pass.
+     *
+     * @param fit
+     * @param functor cost functor of the fit
+     * @param keep cache the residual vector on the fit, not only the sketch
+     */
+    template <typename Functor>
+    void final_residuals(arma_fit &fit, const Functor &functor, bool keep)
+    {
+        const arma_model &model = fit.model;
+        Eigen::VectorXd e;
+        if constexpr (detail::has_residuals<Functor>::value)
+            e = functor.residuals(fit.params);
+        else
+            e = model.arma_residuals(fit.params.phi, fit.params.theta, fit.params.mu);
+
+        sketch::kll quantiles;
+        for (int t = model.r; t < model.n; t++)
+            quantiles.insert(e(t));
+        fit.residual_quantiles = quantiles;
+        if (keep)
+            fit.residuals = std::move(e);
+    }
+
     /**
      * @brief Solve ARMA parameter estimation problem using Ceres optimizer.
      *
@@ -33,12 +91,13 @@ namespace robarma::solver
      * @param method The estimation method
      * @param cost_function The Ceres cost function (non-const pointer, as Ceres may mutate it)
      * @param options The Ceres solver options (const ref)
+     * @param fixed_mu Hold the mu block constant, for cost functions that concentrate it out
      * @return arma_fit containing the optimized parameters and results
      */
     template <typename T>
-    arma_fit solve(const arma_model &model, const arma_fit initial, estimation_method method, ceres::DynamicAutoDiffCostFunction<T> *cost_function, ceres::Solver::Options options)
+    arma_fit solve(const arma_model &model, const arma_fit initial, estimation_method method, ceres::DynamicAutoDiffCostFunction<T> *cost_function, ceres::Solver::Options options, bool fixed_mu = false)
     {
-        robarma::disable_ceres_logging();
+        robarma::silence_solver(options);
         arma_fit opt_params = initial;
 
         auto [phi, theta, mu] = get_pointers(opt_params);
@@ -51,6 +110,8 @@ namespace robarma::solver
         cost_function->SetNumResiduals(1);
 
         problem.AddResidualBlock(cost_function, nullptr, phi, theta, mu);
+        if (fixed_mu)
+            problem.SetParameterBlockConstant(mu);
 
         ceres::Solver::Summary summary;
         ceres::Solve(options, &problem, &summary);
@@ -66,11 +127,388 @@ namespace robarma::solver
         cost_function->Evaluate(parameter_blocks, &cost, nullptr);
 
         estimation_result result = estimation_result(method, success, cost, summary.FullReport());
+        result.iterations = summary.iterations.size();
+        result.evaluations = summary.num_residual_evaluations + summary.num_jacobian_evaluations;
         arma_params params(phi, model.p, theta, model.q, mu);
 
         arma_fit fit(model, params, result, initial.params, initial.result);
         return fit;
     }
+
+    /**
+     * @brief Solve ARMA parameter estimation problem using the native BFGS optimizer.
+     *
+     * Works directly on the cost functor, so no ceres::Problem or cost function is built,
+     * and allocates nothing on the heap unless the text report is requested.
+     *
+     * @param model The ARMA model structure (const ref)
+     * @param initial The initial fit (const ref)
+     * @param method The estimation method
+     * @param functor The cost functor
+     * @param ceres_options The Ceres solver options, whose tolerances are reused
+     * @param report Fill the text report of the result, which is left empty otherwise
+     * @param fixed_mu Hold mu constant, for functors that concentrate it out
+     * @return arma_fit containing the optimized parameters and results
+     */
+    template <typename Functor>
+    arma_fit solve_bfgs(const arma_model &model, const arma_fit &initial, estimation_method method, const Functor &functor, const ceres::Solver::Options &ceres_options, bool report = false, bool fixed_mu = false)
+    {
+        int k = model.p + model.q + 1;
+        int free = fixed_mu ? k - 1 : k;
+        if (k > bfgs::max_parameters)
+            throw std::invalid_argument("BFGS backend supports at most " + std::to_string(bfgs::max_parameters) + " parameters.");
+
+        std::array<double, bfgs::max_parameters> x{};
+        std::copy(initial.params.phi.data(), initial.params.phi.data() + model.p, x.begin());
+        std::copy(initial.params.theta.data(), initial.params.theta.data() + model.q, x.begin() + model.p);
+        x[k - 1] = initial.params.mu;
+
+        bfgs::options opts;
+        opts.max_iterations = ceres_options.max_num_iterations;
+        opts.max_line_search_evaluations = ceres_options.max_num_line_search_step_size_iterations;
+        opts.function_tolerance = ceres_options.function_tolerance;
+        opts.gradient_tolerance = ceres_options.gradient_tolerance;
+        opts.parameter_tolerance = ceres_options.parameter_tolerance;
+
+        auto objective = [&](const double *xt, double *gradient)
+        {
+            return bfgs::value_and_gradient(functor, model.p, model.q, xt, gradient, free);
+        };
+
+        bfgs::summary summary = bfgs::minimize(objective, x.data(), free, opts);
+
+        // Evaluate the cost function value
+        double cost = 0.0;
+        const double *const parameter_blocks[] = {x.data(), x.data() + model.p, x.data() + k - 1};
+        functor(parameter_blocks, &cost);
+
+        estimation_result result(method, summary.convergence, cost);
+        if (report)
+            result.report = summary.report();
+        result.iterations = summary.iterations;
+        result.evaluations = summary.evaluations;
+        arma_params params(x.data(), model.p, x.data() + model.p, model.q, x.data() + k - 1);
+
+        arma_fit fit(model, params, result, initial.params, initial.result);
+        return fit;
+    }
+
+    /**
+     * @brief Solve ARMA parameter estimation problem over the free parameters of a mask.
+     *
+     * The functor is wrapped in mask::cost, so only the free parameters enter the
+     * optimizer and the Jet dimension.
+     *
+     * @param model The ARMA model structure (const ref)
+     * @param initial The initial fit (const ref)
+     * @param method The estimation method
+     * @param functor The cost functor over (phi, theta, mu), owned by the call
+     * @param layout The positions of the free parameters
+     * @param ceres_options The Ceres solver options
+     * @param backend The optimizer
+     * @return arma_fit containing the optimized parameters and results
+     */
+    template <typename Functor>
+    arma_fit solve_masked(const arma_model &model, const arma_fit &initial, estimation_method method, Functor *functor, const mask::layout &layout, const ceres::Solver::Options &ceres_options, solver_backend backend)
+    {
+        using Masked = mask::cost<Functor>;
+
+        int k = layout.size();
+        Eigen::VectorXd x = layout.pack(initial.params);
+        double cost = 0.0;
+        const double *const parameter_blocks[] = {x.data()};
+
+        estimation_result result(method, true, 0.0, "No free parameters");
+
+        if (k > 0 && backend == solver_backend::ceres)
+        {
+            ceres::Solver::Options options = ceres_options;
+            robarma::silence_solver(options);
+
+            auto *cost_function = new ceres::DynamicAutoDiffCostFunction<Masked, 4>(new Masked(functor, layout));
+            cost_function->AddParameterBlock(k);
+            cost_function->SetNumResiduals(1);
+
+            ceres::Problem problem;
+            problem.AddResidualBlock(cost_function, nullptr, x.data());
+
+            ceres::Solver::Summary summary;
+            ceres::Solve(options, &problem, &summary);
+
+            cost_function->Evaluate(parameter_blocks, &cost, nullptr);
+
+            result = estimation_result(method, summary.termination_type == ceres::TerminationType::CONVERGENCE, cost, summary.FullReport());
+            result.iterations = summary.iterations.size();
+            result.evaluations = summary.num_residual_evaluations + summary.num_jacobian_evaluations;
+        }
+        else
+        {
+            Masked masked(functor, layout);
+
+            if (k > 0)
+            {
+                if (k > bfgs::max_parameters)
+                    throw std::invalid_argument("BFGS backend supports at most " + std::to_string(bfgs::max_parameters) + " parameters.");
+
+                bfgs::options opts;
+                opts.max_iterations = ceres_options.max_num_iterations;
+                opts.max_line_search_evaluations = ceres_options.max_num_line_search_step_size_iterations;
+                opts.function_tolerance = ceres_options.function_tolerance;
+                opts.gradient_tolerance = ceres_options.gradient_tolerance;
+                opts.parameter_tolerance = ceres_options.parameter_tolerance;
+
+                auto objective = [&](const double *xt, double *gradient)
+                {
+                    return bfgs::value_and_gradient(masked, xt, gradient, k);
+                };
+
+                bfgs::summary summary = bfgs::minimize(objective, x.data(), k, opts);
+                result = estimation_result(method, summary.convergence, 0.0, summary.report());
+                result.iterations = summary.iterations;
+                result.evaluations = summary.evaluations;
+            }
+
+            masked(parameter_blocks, &cost);
+            result.final_cost = cost;
+        }
+
+        arma_params params = layout.unpack(x.data());
+
+        arma_fit fit(model, params, result, initial.params, initial.result);
+        return fit;
+    }
+
+    /**
+     * @brief Starting parameters of a solve: the warm start over (phi, theta, mu) if given,
+     * the initial parameters otherwise.
+     *
+     * @param model
+     * @param initial
+     * @param start warm start of p + q + 1 entries, or empty
+     * @return arma_params
+     */
+    inline arma_params starting_params(const arma_model &model, const arma_params &initial, const Eigen::VectorXd &start)
+    {
+        if (start.size() == 0)
+            return initial;
+        if (start.size() != model.p + model.q + 1)
+            throw std::invalid_argument("Warm start must have p + q + 1 = " + std::to_string(model.p + model.q + 1) + " entries, got " + std::to_string(start.size()) + ".");
+        return arma_params(start.head(model.p), start.segment(model.p, model.q), start(model.p + model.q));
+    }
+
+    /**
+     * @brief Solve an MM-type estimation problem with the IRLS Gauss-Newton engine.
+     *
+     * @param model The ARMA model structure (const ref)
+     * @param initial The initial fit (const ref)
+     * @param method The estimation method
+     * @tparam Rho rho family of the objective, see rho.hpp
+     * @param sigma The fixed scale of the objective
+     * @param residuals Callable Eigen::VectorXd(phi, theta, mu, Eigen::MatrixXd &J) returning residuals and sensitivities
+     * @param functor The cost functor, evaluated once at the solution to report the cost
+     * @param ceres_options The Ceres solver options, whose tolerances are reused
+     * @param fixed The parameter mask, NaN for estimated parameters
+     * @param start The warm start over (phi, theta, mu), replacing initial as the starting point if not empty
+     * @return arma_fit containing the optimized parameters and results
+     */
+    template <typename Rho = robarma::bip::rho2_family, typename Residuals, typename Functor>
+    arma_fit solve_irls(const arma_model &model, const arma_fit &initial, estimation_method method, double sigma, Residuals residuals, const Functor &functor, const ceres::Solver::Options &ceres_options, const Eigen::VectorXd &fixed = Eigen::VectorXd(), const Eigen::VectorXd &start = Eigen::VectorXd())
+    {
+        int p = model.p;
+        int q = model.q;
+
+        metrics::timer timer;
+        arma_params begin = starting_params(model, initial.params, start);
+        mask::layout layout(model, fixed, begin);
+        Eigen::VectorXd x = layout.pack(begin);
+
+        irls::options opts;
+        opts.max_iterations = ceres_options.max_num_iterations;
+        opts.function_tolerance = ceres_options.function_tolerance;
+        opts.parameter_tolerance = ceres_options.parameter_tolerance;
+
+        Eigen::MatrixXd J_full;
+        auto evaluate = [&](const Eigen::VectorXd &b, Eigen::MatrixXd &J)
+        {
+            Eigen::VectorXd beta = layout.expand(b.data());
+            Eigen::VectorXd e = residuals(Eigen::VectorXd(beta.segment(0, p)), Eigen::VectorXd(beta.segment(p, q)), beta(p + q), J_full);
+            J.resize(J_full.rows(), layout.size());
+            for (int i = 0; i < layout.size(); i++)
+                J.col(i) = J_full.col(layout.free[i]);
+            return e;
+        };
+
+        irls::summary summary = irls::minimize<Rho>(evaluate, sigma, x, opts, model.weights);
+        Eigen::VectorXd beta = layout.expand(x.data());
+
+        // Evaluate the cost function value
+        double cost = 0.0;
+        const double *const parameter_blocks[] = {beta.data(), beta.data() + p, beta.data() + p + q};
+        functor(parameter_blocks, &cost);
+
+        estimation_result result = estimation_result(method, summary.convergence, cost, summary.report());
+        result.iterations = summary.iterations;
+        result.evaluations = summary.evaluations;
+        arma_params params(beta.segment(0, p), beta.segment(p, q), beta(p + q));
+
+        arma_fit fit(model, params, result, initial.params, initial.result);
+
+        metrics::record({method, result.convergence, result.iterations, result.evaluations, 1, model.n, timer.seconds()});
+        return fit;
+    }
+
+    /**
+     * @brief Solve ARMA parameter estimation problem with estimator options.
+     *
+     * The cost functor is built through a factory so that it can be instantiated for
+     * coarse subsamples of the series. With coarse-to-fine enabled, each subsample
+     * stage is warm-started from the previous one and the final solve on the full
+     * series starts from the last subsample solution. With concentrate_mu, the functor
+     * is wrapped in profile::cost and mu is recovered from its location rule at the end.
+     * With a parameter mask, only the free parameters are optimized, see solve_masked.
+     * A non-converged solve on the full series is retried along options.fallback.
+     * With options.start, the solve starts from the warm start instead of initial.
+     * The residuals and their quantile sketch are computed once, at the final parameters,
+     * see final_residuals.
+     *
+     * @param model The ARMA model structure (const ref)
+     * @param initial The initial fit (const ref)
+     * @param method The estimation method
+     * @param make_cost Callable returning a cost functor by value for a given arma_model
+     * @param ceres_options The Ceres solver options
+     * @param options The estimator options
+     * @return arma_fit containing the optimized parameters and results
+     */
+    template <typename Factory>
+    arma_fit solve(const arma_model &model, const arma_fit &initial, estimation_method method, Factory make_cost, ceres::Solver::Options ceres_options, const estimation_options &options)
+    {
+        using Functor = std::invoke_result_t<Factory, const arma_model &>;
+        using Profiled = profile::cost<Functor>;
+
+        metrics::timer timer;
+        bool masked = mask::any_fixed(options.fixed);
+        bool fixed_mu = options.concentrate_mu && !(masked && !std::isnan(options.fixed(options.fixed.size() - 1)));
+
+        auto solve_stage = [&](const arma_model &m, const arma_fit &stage_initial, const ceres::Solver::Options &ceres_options, solver_backend backend)
+        {
+            if (masked)
+            {
+                mask::layout layout(m, options.fixed, stage_initial.params, fixed_mu);
+                if (fixed_mu)
+                    return solve_masked(m, stage_initial, method, new Profiled(make_cost(m), m), layout, ceres_options, backend);
+                return solve_masked(m, stage_initial, method, new Functor(make_cost(m)), layout, ceres_options, backend);
+            }
+            if (fixed_mu)
+            {
+                if (backend == solver_backend::bfgs)
+                {
+                    const Profiled functor{make_cost(m), m};
+                    return solve_bfgs(m, stage_initial, method, functor, ceres_options, options.report, true);
+                }
+                auto *cost_function = new ceres::DynamicAutoDiffCostFunction<Profiled, 4>(new Profiled(make_cost(m), m));
+                return solve(m, stage_initial, method, cost_function, ceres_options, true);
+            }
+            if (backend == solver_backend::bfgs)
+            {
+                const Functor functor = make_cost(m);
+                return solve_bfgs(m, stage_initial, method, functor, ceres_options, options.report);
+            }
+            auto *cost_function = new ceres::DynamicAutoDiffCostFunction<Functor, 4>(new Functor(make_cost(m)));
+            return solve(m, stage_initial, method, cost_function, ceres_options);
+        };
+
+        arma_params start = starting_params(model, initial.params, options.start);
+        double subsample_evaluations = 0.0;
+
+        for (int size : options.coarse_to_fine.schedule(model.n))
+        {
+            arma_model subsample = arma_model::view(Eigen::Map<const Eigen::VectorXd>(model.y.data() + model.n - size, size), model.p, model.q);
+            if (model.weighted())
+                subsample.set_weights(model.weights.tail(size));
+            arma_fit stage = solve_stage(subsample, arma_fit(subsample, start, initial.result), ceres_options, options.backend);
+
+            start = stage.params;
+            subsample_evaluations += stage.result.evaluations * double(size) / model.n;
+        }
+
+        std::optional<arma_fit> best = solve_stage(model, arma_fit(model, start, initial.result), ceres_options, options.backend);
+
+        auto record = [](const char *strategy, const estimation_result &result)
+        {
+            return estimation_attempt{strategy, result.convergence, result.final_cost, result.iterations, result.evaluations};
+        };
+
+        std::vector<estimation_attempt> attempts{record("initial", best->result)};
+        int evaluations = best->result.evaluations;
+
+        // Fallback ladder: retry non-converged fits within the evaluation budget
+        for (fallback_step step : options.fallback.ladder)
+        {
+            if (!options.fallback.enabled || best->result.convergence || evaluations >= options.fallback.max_evaluations)
+                break;
+
+            ceres::Solver::Options retry_options = ceres_options;
+            solver_backend backend = options.backend;
+            arma_params retry_start = std::isfinite(best->result.final_cost) ? best->params : initial.params;
+
+            switch (step)
+            {
+            case fallback_step::robust_start:
+                retry_start = robarma::initial::robust_yule_walker(model).params;
+                break;
+            case fallback_step::line_search_direction:
+                backend = solver_backend::ceres;
+                retry_options.minimizer_type = ceres::LINE_SEARCH;
+                retry_options.line_search_direction_type = (ceres_options.line_search_direction_type == ceres::LBFGS) ? ceres::BFGS : ceres::LBFGS;
+                break;
+            case fallback_step::trust_region:
+                backend = solver_backend::ceres;
+                retry_options.minimizer_type = ceres::TRUST_REGION;
+                break;
+            }
+
+            // Cap the retry by the remaining budget: besides its initial evaluation, an iteration
+            // evaluates at most once per line search trial, or once for a trust-region step
+            int remaining = options.fallback.max_evaluations - evaluations - 1;
+            int per_iteration = 1;
+            if (retry_options.minimizer_type == ceres::LINE_SEARCH || backend == solver_backend::bfgs)
+            {
+                int &trials = retry_options.max_num_line_search_step_size_iterations;
+                trials = std::max(1, std::min(trials, remaining - 1));
+                per_iteration += trials;
+            }
+            retry_options.max_num_iterations = std::min(options.fallback.max_iterations, remaining / per_iteration);
+            if (retry_options.max_num_iterations < 1)
+                break;
+
+            metrics::diagnostic(method, to_string(step));
+            arma_fit retry = solve_stage(model, arma_fit(model, retry_start, initial.result), retry_options, backend);
+            attempts.push_back(record(to_string(step), retry.result));
+            evaluations += retry.result.evaluations;
+
+            // Only a lower cost replaces the best fit, so a retry that stops at its start, as the
+            // trust region on the scalar cost can, does not relabel a failed fit as converged
+            bool finite = std::isfinite(retry.result.final_cost);
+            if (finite && (retry.result.final_cost < best->result.final_cost || !std::isfinite(best->result.final_cost)))
+                best.emplace(retry);
+        }
+
+        arma_fit fit = *best;
+        fit.result.attempts = attempts;
+
+        // Residuals once, at the final parameters of the full series
+        const Functor functor = make_cost(model);
+        if (fixed_mu)
+            fit.params.mu = Profiled(functor, model).location(fit.params);
+        final_residuals(fit, functor, options.keep_residuals);
+
+        fit.initial_params = initial.params;
+        fit.initial_result = initial.result;
+        fit.result.subsample_evaluations = subsample_evaluations;
+
+        metrics::record({method, fit.result.convergence, fit.result.iterations, evaluations, int(attempts.size()), model.n, timer.seconds()});
+        return fit;
+    }
 } // namespace robarma::solver
 
 // end of file
\ No newline at end of file
@@ -28,6 +28,15 @@ namespace robarma
             return F;
         }
 
+        // First column of F0, phi padded with zeros to length r
+        template <typename T>
+        Vec<T> phi0(const Vec<T> phi) const
+        {
+            Vec<T> f = Vec<T>::Zero(r);
+            f.segment(0, model.p) = phi;
+            return f;
+        }
+
         template <typename T>
         Vec<T> H0(const Vec<T> theta) const
         {
@@ -56,6 +65,47 @@ namespace robarma
             return z;
         }
 
+        /**
+         * @brief Prediction step a = F a + c, P = F P F' + s2 H H' in O(r^2)
+         *
+         * F = F0(phi) is a companion matrix: phi in the first column and ones on the
+         * superdiagonal, i.e. F = f e_0' + S with f = phi0(phi) and S the shift up by one.
+         * Hence F a = a_0 f + S a and
+         *
+         *     F P F' = S P S' + f g' + g f',   g = S P e_0 + (P_00 / 2) f,
+         *
+         * so the step is a shift plus a rank-two update instead of two dense r x r products.
+         *
+         * @param a state, updated in place
+         * @param P state covariance, updated in place
+         * @param f first column of F, see phi0
+         * @param H
+         * @param s2 innovation variance
+         * @param c
+         */
+        template <typename T>
+        void companion_predict(Vec<T> &a, Mat<T> &P, const Vec<T> &f, const Vec<T> &H, const T s2, const Vec<T> &c) const
+        {
+            T a0 = a(0);
+            for (int i = 0; i < r - 1; i++)
+                a(i) = a(i + 1);
+            a(r - 1) = T(0);
+            a += a0 * f + c;
+
+            Vec<T> g = Vec<T>::Zero(r);
+            g.head(r - 1) = P.col(0).tail(r - 1);
+            g += (P(0, 0) / T(2)) * f;
+
+            // S P S', shifting up and left in place; (i + 1, j + 1) is read before it is written
+            for (int j = 0; j < r - 1; j++)
+                for (int i = 0; i < r - 1; i++)
+                    P(i, j) = P(i + 1, j + 1);
+            P.row(r - 1).setZero();
+            P.col(r - 1).setZero();
+
+            P += f * g.transpose() + g * f.transpose() + s2 * H * H.transpose();
+        }
+
         template <typename T>
         Vec<T> c0(const Vec<T> phi, const T mu) const
         {
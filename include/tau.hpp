@@ -8,6 +8,7 @@
 
 #include <Eigen/Dense>
 #include <alias.hpp>
+#include <rho.hpp>
 #include <robust.hpp>
 
 /**
@@ -16,78 +17,78 @@
  */
 namespace robarma::tau
 {
-    template <typename T>
+    // The functions take the rho family as an optional second template argument,
+    // defaulting to the tuning of \cite Bianco, see rho::tau_pair.
+
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline T rho1(const T x)
     {
-        T c = T(1.55);
-        T div = x / c;
-
-        if (ceres::abs(x) <= c)
-        {
-            return T(3) * ceres::pow(div, 2) - T(3) * ceres::pow(div, 4) + ceres::pow(div, 6);
-        }
-        return T(1);
+        return Pair::first::rho(x);
     }
 
-    template <typename T>
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline Vec<T> rho1(const Vec<T> x)
     {
-        return x.unaryExpr(static_cast<T (*)(const T)>(&rho1));
+        return x.unaryExpr([](const T &xi)
+                           { return rho1<T, Pair>(xi); });
     }
 
-    template <typename T>
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline T rho2(const T x)
     {
-        T c = T(2.8);
-
-        if (ceres::abs(x) <= c)
-        {
-            return T(0.14) * ceres::pow(x, 2) + T(0.012) * ceres::pow(x, 4) - T(0.0018) * ceres::pow(x, 6);
-        }
-        return T(1);
+        return Pair::second::rho(x);
     }
 
-    template <typename T>
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline Vec<T> rho2(const Vec<T> x)
     {
-        return x.unaryExpr(static_cast<T (*)(const T)>(&rho2));
+        return x.unaryExpr([](const T &xi)
+                           { return rho2<T, Pair>(xi); });
     }
 
-    template <typename T>
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline T psi(T x)
     {
         // Function psi is a bounded odd function
-        T c = T(1.55);
-        if (ceres::abs(x) <= c)
-        {
-            return x;
-        }
-        return (x > T(0)) ? c : -c;
+        return Pair::filter::psi(x);
     }
 
-    template <typename T>
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline T w(T x)
     {
         if (x == T(0))
         {
             return T(0);
         }
-        return psi<T>(x) / x;
+        return psi<T, Pair>(x) / x;
     }
 
-    template <typename T>
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline T s(Vec<T> u)
     {
         // Assume that u is a vector of residuals
-        std::function<Vec<T>(Vec<T>)> func = static_cast<Vec<T> (*)(const Vec<T>)>(&rho1);
-        return robarma::base::scale(u, T(0.5), func);
+        return robarma::rho::scale<typename Pair::first>(u);
     }
 
-    template <typename T>
+    template <typename T, typename Pair = rho::tau_pair<>>
     inline T tau2(Vec<T> u)
     {
-        T sn = s(u);
-        return ceres::pow(sn, 2) * rho2((u / sn).eval()).sum();
+        T sn = s<T, Pair>(u);
+        return ceres::pow(sn, 2) * rho2<T, Pair>((u / sn).eval()).sum();
+    }
+
+    // Weighted tau-scale, with the weighted M-scale and weighted rho2 sum; empty w is unweighted
+    template <typename T, typename Pair = rho::tau_pair<>>
+    inline T tau2(Vec<T> u, const Eigen::VectorXd &w)
+    {
+        if (w.size() == 0)
+            return tau2<T, Pair>(u);
+
+        T sn = robarma::rho::scale<typename Pair::first>(u, w);
+        T sum = T(0);
+        for (int t = 0; t < u.size(); t++)
+            sum += w(t) * rho2<T, Pair>(u(t) / sn);
+        return ceres::pow(sn, 2) * sum;
     }
 } // namespace robarma::tau
-// end of file
\ No newline at end of file
+// end of file
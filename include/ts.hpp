@@ -6,6 +6,7 @@
 #pragma once
 
 #include <Eigen/Dense>
+#include <algorithm>
 #include <alias.hpp>
 #include <arma.hpp>
 #include <robust.hpp>
@@ -70,6 +71,197 @@ namespace robarma
         return a;
     }
 
+    // Sample autocovariances gamma(0), ..., gamma(max_lag) around the given location.
+    // Uses the biased divisor N, which keeps the implied Toeplitz matrix positive definite.
+    template <typename T>
+    inline Vec<T> autocov(const Vec<T> &y, const int &max_lag, const T &location)
+    {
+        int N = y.size();
+        Vec<T> yc = y.array() - location;
+        Vec<T> gamma = Vec<T>::Zero(max_lag + 1);
+
+        for (int h = 0; h <= max_lag && h < N; ++h)
+        {
+            gamma(h) = yc.segment(0, N - h).dot(yc.segment(h, N - h)) / T(N);
+        }
+        return gamma;
+    }
+
+    template <typename T>
+    inline Vec<T> autocov(const Vec<T> &y, const int &max_lag)
+    {
+        return autocov(y, max_lag, T(y.mean()));
+    }
+
+    /**
+     * @brief Robust autocovariances gamma(0), ..., gamma(max_lag)
+     *
+     * Uses the identity 4 cov(X, Y) = var(X + Y) - var(X - Y) with the variances
+     * replaced by squared MADN of the sums and differences of lagged pairs, which
+     * is Fisher-consistent at the normal distribution. Each lag costs O(N).
+     *
+     * @param y time series
+     * @param max_lag
+     * @param location robust location of y, eg. median
+     * @param scale robust scale of y, used for gamma(0)
+     * @return Vec<T>
+     */
+    template <typename T>
+    inline Vec<T> robust_autocov(const Vec<T> &y, const int &max_lag, const T &location, const T &scale)
+    {
+        int N = y.size();
+        Vec<T> yc = y.array() - location;
+        Vec<T> gamma = Vec<T>::Zero(max_lag + 1);
+        gamma(0) = scale * scale;
+
+        auto madn = [](Vec<T> x)
+        {
+            T med = robarma::base::median(x);
+            Vec<T> dev = (x.array() - med).abs();
+            return robarma::base::median(dev) / T(0.6745);
+        };
+
+        for (int h = 1; h <= max_lag && h < N - 1; ++h)
+        {
+            T s_plus = madn(yc.segment(0, N - h) + yc.segment(h, N - h));
+            T s_minus = madn(yc.segment(0, N - h) - yc.segment(h, N - h));
+
+            T a = s_plus * s_plus;
+            T b = s_minus * s_minus;
+            gamma(h) = gamma(0) * (a - b) / (a + b);
+        }
+        return gamma;
+    }
+
+    /**
+     * @brief Durbin-Levinson recursion
+     *
+     * Solves the Yule-Walker equations of an AR(m) process from autocovariances
+     * gamma(0), ..., gamma(m) in O(m^2) without forming the Toeplitz matrix.
+     *
+     * @param gamma autocovariances, at least m + 1 values
+     * @param m order of the autoregression
+     * @param variance (optional) output for the one-step prediction error variance
+     * @return Vec<T> AR coefficients phi_1, ..., phi_m
+     */
+    template <typename T>
+    inline Vec<T> levinson_durbin(const Vec<T> &gamma, const int &m, T *variance = nullptr)
+    {
+        Vec<T> phi = Vec<T>::Zero(m);
+        Vec<T> prev = Vec<T>::Zero(m);
+        T v = gamma(0);
+
+        for (int k = 0; k < m; ++k)
+        {
+            T acc = gamma(k + 1);
+            for (int j = 0; j < k; ++j)
+                acc -= prev(j) * gamma(k - j);
+
+            T kappa = acc / v;
+            for (int j = 0; j < k; ++j)
+                phi(j) = prev(j) - kappa * prev(k - 1 - j);
+            phi(k) = kappa;
+
+            v *= T(1) - kappa * kappa;
+            prev.head(k + 1) = phi.head(k + 1);
+        }
+
+        if (variance)
+            *variance = v;
+        return phi;
+    }
+
+    /**
+     * @brief Innovations algorithm for an MA(q) autocovariance sequence
+     *
+     * Runs m steps of the innovations algorithm on kappa(0), ..., kappa(q), treating
+     * kappa(h) = 0 for h > q, and returns theta_{m, 1}, ..., theta_{m, q} which converge
+     * to the invertible MA(q) coefficients. See Brockwell & Davis, Prop. 5.2.2.
+     *
+     * @param kappa autocovariances of the MA(q) process
+     * @param q
+     * @param m number of steps
+     * @param variance (optional) output for the innovation variance v_m
+     * @return Vec<T>
+     */
+    template <typename T>
+    inline Vec<T> innovations(const Vec<T> &kappa, const int &q, const int &m, T *variance = nullptr)
+    {
+        auto k = [&](int h)
+        { return (h <= q) ? kappa(h) : T(0); };
+
+        Mat<T> theta = Mat<T>::Zero(m + 1, m + 1);
+        Vec<T> v = Vec<T>::Zero(m + 1);
+        v(0) = k(0);
+
+        for (int n = 1; n <= m; ++n)
+        {
+            for (int j = std::max(0, n - q); j < n; ++j)
+            {
+                T acc = k(n - j);
+                for (int i = std::max(0, n - q); i < j; ++i)
+                    acc -= theta(j, j - i) * theta(n, n - i) * v(i);
+                theta(n, n - j) = acc / v(j);
+            }
+            v(n) = k(0);
+            for (int j = std::max(0, n - q); j < n; ++j)
+                v(n) -= theta(n, n - j) * theta(n, n - j) * v(j);
+        }
+
+        if (variance)
+            *variance = v(m);
+        return theta.row(m).segment(1, q).transpose();
+    }
+
+    /**
+     * @brief ARMA(p, q) coefficients from autocovariances gamma(0), ..., gamma(p + q)
+     *
+     * The AR part solves the (extended) Yule-Walker equations, with Durbin-Levinson
+     * when q = 0. The MA part applies the innovations algorithm to the autocovariances
+     * of the AR-filtered process phi(B) y_t.
+     *
+     * @param gamma autocovariances
+     * @param p
+     * @param q
+     * @param m number of innovations steps for the MA part
+     * @return std::tuple<Vec<T>, Vec<T>> (phi, theta)
+     */
+    template <typename T>
+    inline std::tuple<Vec<T>, Vec<T>> arma_from_autocov(const Vec<T> &gamma, const int &p, const int &q, const int &m = 50)
+    {
+        auto g = [&](int h)
+        { return gamma(std::abs(h)); };
+
+        Vec<T> phi;
+        if (q == 0)
+        {
+            phi = levinson_durbin<T>(gamma, p);
+            return std::make_tuple(phi, Vec<T>());
+        }
+
+        Mat<T> A(p, p);
+        Vec<T> b(p);
+        for (int i = 0; i < p; ++i)
+        {
+            for (int j = 0; j < p; ++j)
+                A(i, j) = g(q + i - j);
+            b(i) = g(q + i + 1);
+        }
+        phi = A.partialPivLu().solve(b);
+
+        // Autocovariances of w_t = phi(B) y_t up to lag q
+        Vec<T> a(p + 1);
+        a << T(1), -phi;
+        Vec<T> kappa = Vec<T>::Zero(q + 1);
+        for (int h = 0; h <= q; ++h)
+            for (int j = 0; j <= p; ++j)
+                for (int k = 0; k <= p; ++k)
+                    kappa(h) += a(j) * a(k) * g(h + j - k);
+
+        Vec<T> theta = innovations<T>(kappa, q, std::max(m, q));
+        return std::make_tuple(phi, theta);
+    }
+
     template <typename T>
     inline Vec<T> causal(Vec<T> phi, Vec<T> theta)
     {
@@ -95,6 +287,207 @@ namespace robarma
         return lambda.tail(n - 1);
     }
 
+    /**
+     * @brief Step-down Levinson recursion
+     *
+     * Inverts Durbin-Levinson: recovers the partial autocorrelations kappa_1, ..., kappa_p
+     * of a stationary AR(p) process from its coefficients in O(p^2). The process is
+     * stationary if and only if all |kappa_k| < 1.
+     *
+     * @param phi AR coefficients
+     * @param ok (optional) set to false if a |kappa_k| >= 1 is met, the recursion stops there
+     * @return Vec<T> partial autocorrelations
+     */
+    template <typename T>
+    inline Vec<T> partial_autocorrelations(const Vec<T> &phi, bool *ok = nullptr)
+    {
+        int p = phi.size();
+        Vec<T> kappa = Vec<T>::Zero(p);
+        Vec<T> a = phi;
+        Vec<T> prev(p);
+
+        if (ok)
+            *ok = true;
+
+        for (int k = p; k >= 1; --k)
+        {
+            kappa(k - 1) = a(k - 1);
+            T d = T(1) - kappa(k - 1) * kappa(k - 1);
+            if (!(d > T(0)))
+            {
+                if (ok)
+                    *ok = false;
+                break;
+            }
+            for (int j = 0; j < k - 1; ++j)
+                prev(j) = (a(j) + kappa(k - 1) * a(k - 2 - j)) / d;
+            a.head(k - 1) = prev.head(k - 1);
+        }
+        return kappa;
+    }
+
+    /**
+     * @brief Quadratic AR objective in the lag coefficients and the location
+     *
+     * Holds D(mu) = G - mu A + mu^2 N, so that the objective at beta = (1, -phi_1, ..., -phi_p)
+     * is beta' D(mu) beta. Built once from lag_products, each evaluation costs O(p^2)
+     * regardless of the length of the series.
+     */
+    struct ar_moments
+    {
+        Eigen::MatrixXd G;
+        Eigen::MatrixXd A;
+        Eigen::MatrixXd N;
+
+        template <typename T>
+        T value(const Vec<T> &phi, const T mu) const
+        {
+            int k = G.rows();
+            T total = T(0);
+            for (int i = 0; i < k; i++)
+            {
+                T bi = (i == 0) ? T(1) : -phi(i - 1);
+                T row = T(0);
+                for (int j = 0; j < k; j++)
+                {
+                    T bj = (j == 0) ? T(1) : -phi(j - 1);
+                    row += (G(i, j) - mu * A(i, j) + mu * mu * N(i, j)) * bj;
+                }
+                total += bi * row;
+            }
+            return total;
+        }
+
+        // Location minimizing the objective for given coefficients
+        template <typename T>
+        T location(const Vec<T> &phi) const
+        {
+            int k = G.rows();
+            T linear = T(0);
+            T quadratic = T(0);
+            for (int i = 0; i < k; i++)
+            {
+                T bi = (i == 0) ? T(1) : -phi(i - 1);
+                for (int j = 0; j < k; j++)
+                {
+                    T bj = (j == 0) ? T(1) : -phi(j - 1);
+                    linear += bi * bj * A(i, j);
+                    quadratic += bi * bj * N(i, j);
+                }
+            }
+            return linear / (T(2) * quadratic);
+        }
+    };
+
+    /**
+     * @brief Lagged cross-product sums of a series
+     *
+     * The sufficient statistics of AR(p) objectives. The lag products
+     * r(h) = sum_u y_u y_{u+h} for h <= max_lag and the prefix sums of y are computed once in
+     * O(n max_lag). Windowed sums sum_{u=a}^{b} y_u y_{u+h} then follow by removing the few
+     * terms outside the window, so the moments of every AR order up to max_lag, for
+     * conditional or exact objectives, are built without another pass over the series.
+     * The series is referenced, not copied, and must outlive the lag products.
+     */
+    struct lag_products
+    {
+        Eigen::Ref<const Eigen::VectorXd> y;
+        int max_lag;
+        Eigen::VectorXd r;
+        Eigen::VectorXd prefix;
+
+        lag_products(Eigen::Ref<const Eigen::VectorXd> y, int max_lag)
+            : y(y), max_lag(max_lag)
+        {
+            int n = y.size();
+            r = Eigen::VectorXd::Zero(max_lag + 1);
+            for (int h = 0; h <= max_lag && h < n; h++)
+                r(h) = y.head(n - h).dot(y.tail(n - h));
+
+            prefix = Eigen::VectorXd::Zero(n + 1);
+            for (int u = 0; u < n; u++)
+                prefix(u + 1) = prefix(u) + y(u);
+        }
+
+        // sum_{u=a}^{b} y_u
+        double sum(int a, int b) const
+        {
+            return (b < a) ? 0.0 : prefix(b + 1) - prefix(a);
+        }
+
+        // sum_{u=a}^{b} y_u y_{u+h}, for h <= max_lag and b + h < n
+        double product(int h, int a, int b) const
+        {
+            if (b < a)
+                return 0.0;
+
+            int last = y.size() - 1 - h;
+            double value = r(h);
+            for (int u = 0; u < a; u++)
+                value -= y(u) * y(u + h);
+            for (int u = b + 1; u <= last; u++)
+                value -= y(u) * y(u + h);
+            return value;
+        }
+
+        /**
+         * @brief Moments of the conditional sum of squares of an AR(k) model
+         *
+         * sum_{t=k}^{n-1} (beta' (Y_t - mu))^2 with Y_t = (y_t, y_{t-1}, ..., y_{t-k}), the
+         * least squares objective of a pure AR(k) model.
+         *
+         * @param k AR order, at most max_lag
+         * @return ar_moments
+         */
+        ar_moments conditional(int k) const
+        {
+            int n = y.size();
+            ar_moments m{Eigen::MatrixXd(k + 1, k + 1), Eigen::MatrixXd(k + 1, k + 1), Eigen::MatrixXd(k + 1, k + 1)};
+            for (int i = 0; i <= k; i++)
+            {
+                for (int j = i; j <= k; j++)
+                {
+                    // t - j runs over [k - j, n - 1 - j], t - i = (t - j) + (j - i)
+                    int a = k - j;
+                    int b = n - 1 - j;
+                    m.G(i, j) = m.G(j, i) = product(j - i, a, b);
+                    m.A(i, j) = m.A(j, i) = sum(a, b) + sum(a + j - i, b + j - i);
+                    m.N(i, j) = m.N(j, i) = double(b - a + 1);
+                }
+            }
+            return m;
+        }
+
+        /**
+         * @brief Moments of the exact Gaussian quadratic form of an AR(k) model
+         *
+         * (y - mu)' V_n^-1 (y - mu) for the n x n covariance V_n of a stationary AR(k)
+         * process with unit innovation variance equals beta' D beta with
+         * D(i, j) = sum_{t=i}^{n-1-j} x_t x_{t+j-i} for i <= j, x = y - mu
+         * (Box and Jenkins, Appendix A7.4).
+         *
+         * @param k AR order, at most max_lag
+         * @return ar_moments
+         */
+        ar_moments exact(int k) const
+        {
+            int n = y.size();
+            ar_moments m{Eigen::MatrixXd(k + 1, k + 1), Eigen::MatrixXd(k + 1, k + 1), Eigen::MatrixXd(k + 1, k + 1)};
+            for (int i = 0; i <= k; i++)
+            {
+                for (int j = i; j <= k; j++)
+                {
+                    int a = i;
+                    int b = n - 1 - j;
+                    m.G(i, j) = m.G(j, i) = product(j - i, a, b);
+                    m.A(i, j) = m.A(j, i) = sum(a, b) + sum(a + j - i, b + j - i);
+                    m.N(i, j) = m.N(j, i) = double(std::max(b - a + 1, 0));
+                }
+            }
+            return m;
+        }
+    };
+
 } // namespace robarma
 
 // end of file
\ No newline at end of file
@@ -0,0 +1,247 @@
+/**
+ * @file robarma_c.cpp
+ * @brief C API of robarma.h, compiled on top of the header-only library.
+ *
+ * Each series is viewed in the caller's buffer through an Eigen::Map and fitted on the
+ * batch thread pool; the fields of every fit are written straight into the caller's output
+ * columns. No exception crosses the C boundary: failures of single series are recorded in
+ * their outputs, all others are turned into a status and a thread-local message.
+ *
+ */
+#include <robarma.h>
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <batch.hpp>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <estimators.hpp>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <options.hpp>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    thread_local std::string last_error;
+
+    robarma_status fail(robarma_status status, const std::string &message)
+    {
+        last_error = message;
+        return status;
+    }
+
+    // Smallest sizes of the structs, up to the last field of version 1
+    constexpr std::size_t options_v1 = offsetof(robarma_options, bfgs) + sizeof(robarma_options::bfgs);
+    constexpr std::size_t fits_v1 = offsetof(robarma_fits, seconds) + sizeof(robarma_fits::seconds);
+
+    // Copy of a caller struct of any known version: fields beyond its size keep their defaults
+    template <typename T>
+    T upgrade(const T &in, T defaults)
+    {
+        std::memcpy(&defaults, &in, std::min(in.size, sizeof(T)));
+        defaults.size = sizeof(T);
+        return defaults;
+    }
+
+    void parse(const robarma_options &caller, robarma::estimation_method &method, robarma::estimation_options &options, int &threads)
+    {
+        if (caller.size < options_v1)
+            throw std::invalid_argument("robarma_options has an unknown size; initialize it with robarma_default_options.");
+
+        robarma_options in;
+        robarma_default_options(&in);
+        in = upgrade(caller, in);
+        if (in.method < ROBARMA_HANNAN_RISSANEN || in.method > ROBARMA_ROBUST_YW)
+            throw std::invalid_argument("Unknown estimation method " + std::to_string(in.method) + ".");
+
+        method = static_cast<robarma::estimation_method>(in.method);
+        threads = in.threads;
+        options.irls = in.irls != 0;
+        options.concentrate_mu = in.concentrate_mu != 0;
+        options.fallback.enabled = in.fallback != 0;
+        options.backend = in.bfgs ? robarma::solver_backend::bfgs : robarma::solver_backend::ceres;
+
+        // Only parameters and summaries are returned, so the fits need not cache residuals
+        options.keep_residuals = false;
+    }
+
+    void store(const robarma_fits &out, std::int64_t m, std::int64_t i, const robarma::arma_fit &fit, double seconds)
+    {
+        const robarma::arma_params &params = fit.params;
+        if (out.phi)
+            for (int j = 0; j < params.phi.size(); j++)
+                out.phi[j * m + i] = params.phi(j);
+        if (out.theta)
+            for (int j = 0; j < params.theta.size(); j++)
+                out.theta[j * m + i] = params.theta(j);
+        if (out.mu)
+            out.mu[i] = params.mu;
+        if (out.cost)
+            out.cost[i] = fit.result.final_cost;
+        if (out.convergence)
+            out.convergence[i] = fit.result.convergence;
+        if (out.iterations)
+            out.iterations[i] = fit.result.iterations;
+        if (out.seconds)
+            out.seconds[i] = seconds;
+    }
+
+    // Outputs of a series that could not be fitted
+    void store_failure(const robarma_fits &out, std::int64_t m, std::int64_t i, int p, int q)
+    {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        if (out.phi)
+            for (int j = 0; j < p; j++)
+                out.phi[j * m + i] = nan;
+        if (out.theta)
+            for (int j = 0; j < q; j++)
+                out.theta[j * m + i] = nan;
+        if (out.mu)
+            out.mu[i] = nan;
+        if (out.cost)
+            out.cost[i] = nan;
+        if (out.convergence)
+            out.convergence[i] = 0;
+        if (out.iterations)
+            out.iterations[i] = 0;
+        if (out.seconds)
+            out.seconds[i] = 0.0;
+    }
+
+    // Shortest series the Hannan-Rissanen start can be computed for: the long autoregression
+    // of order 2 max(p, q) + 1 and max(p, q) + 1 lags leave at least p + q regression rows
+    std::int64_t min_length(int p, int q)
+    {
+        return 3 * std::int64_t(std::max(p, q)) + 2 + p + q;
+    }
+
+    robarma_status fit_series(const double *values, const std::int64_t *offsets, const std::int64_t *lengths, std::int64_t m, int p, int q, const robarma_options *options, const robarma_fits *caller)
+    {
+        if (!values || !offsets || !lengths || !caller)
+            return fail(ROBARMA_INVALID_ARGUMENT, "Null input or output buffer.");
+        if (caller->size < fits_v1)
+            return fail(ROBARMA_INVALID_ARGUMENT, "robarma_fits has an unknown size; set its size member to sizeof(robarma_fits).");
+        if (m < 0 || m > std::numeric_limits<int>::max() || p < 0 || q < 0)
+            return fail(ROBARMA_INVALID_ARGUMENT, "Invalid panel size or model order.");
+        for (std::int64_t i = 0; i < m; i++)
+        {
+            if (offsets[i] < 0 || lengths[i] < 0 || lengths[i] > std::numeric_limits<int>::max())
+                return fail(ROBARMA_INVALID_ARGUMENT, "Invalid offset or length of series " + std::to_string(i) + ".");
+            if (lengths[i] < min_length(p, q))
+                return fail(ROBARMA_INVALID_ARGUMENT, "Series " + std::to_string(i) + " of length " + std::to_string(lengths[i]) + " is too short for an ARMA(" + std::to_string(p) + ", " + std::to_string(q) + ") model, at least " + std::to_string(min_length(p, q)) + " values are needed.");
+        }
+        const robarma_fits outputs = upgrade(*caller, robarma_fits{});
+        const robarma_fits *out = &outputs;
+
+        robarma_options defaults;
+        robarma_default_options(&defaults);
+
+        robarma::estimation_method method;
+        robarma::estimation_options estimation;
+        int threads;
+        parse(options ? *options : defaults, method, estimation, threads);
+
+        std::mutex error_mutex;
+        std::string first_error;
+
+        robarma::batch::parallel_for(int(m), threads, [&](int i)
+                                     {
+            auto start = std::chrono::steady_clock::now();
+            try
+            {
+                // The model maps the caller's values, the series is not copied
+                Eigen::Map<const Eigen::VectorXd> y(values + offsets[i], lengths[i]);
+                robarma::arma_model model = robarma::arma_model::view(y, p, q);
+                robarma::arma_fit fit = robarma::estimators::fit(model, method, estimation);
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                store(*out, m, i, fit, elapsed.count());
+            }
+            catch (const std::exception &e)
+            {
+                store_failure(*out, m, i, p, q);
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (first_error.empty())
+                    first_error = "Series " + std::to_string(i) + ": " + e.what();
+            } });
+
+        if (!first_error.empty())
+            return fail(ROBARMA_FIT_FAILED, first_error);
+        last_error.clear();
+        return ROBARMA_OK;
+    }
+} // namespace
+
+extern "C"
+{
+    int robarma_api_version(void)
+    {
+        return ROBARMA_C_API_VERSION;
+    }
+
+    void robarma_default_options(robarma_options *options)
+    {
+        if (!options)
+            return;
+        robarma::estimation_options defaults;
+        options->size = sizeof(robarma_options);
+        options->method = ROBARMA_MM;
+        options->threads = 0;
+        options->irls = defaults.irls;
+        options->concentrate_mu = defaults.concentrate_mu;
+        options->fallback = defaults.fallback.enabled;
+        options->bfgs = defaults.backend == robarma::solver_backend::bfgs;
+    }
+
+    robarma_status robarma_fit(const double *y, int64_t n, int p, int q, const robarma_options *options, const robarma_fits *out)
+    {
+        try
+        {
+            std::int64_t offset = 0;
+            return fit_series(y, &offset, &n, 1, p, q, options, out);
+        }
+        catch (const std::invalid_argument &e)
+        {
+            return fail(ROBARMA_INVALID_ARGUMENT, e.what());
+        }
+        catch (const std::exception &e)
+        {
+            return fail(ROBARMA_ERROR, e.what());
+        }
+        catch (...)
+        {
+            return fail(ROBARMA_ERROR, "Unknown error.");
+        }
+    }
+
+    robarma_status robarma_fit_panel(const double *values, const int64_t *offsets, const int64_t *lengths, int64_t m, int p, int q, const robarma_options *options, const robarma_fits *out)
+    {
+        try
+        {
+            return fit_series(values, offsets, lengths, m, p, q, options, out);
+        }
+        catch (const std::invalid_argument &e)
+        {
+            return fail(ROBARMA_INVALID_ARGUMENT, e.what());
+        }
+        catch (const std::exception &e)
+        {
+            return fail(ROBARMA_ERROR, e.what());
+        }
+        catch (...)
+        {
+            return fail(ROBARMA_ERROR, "Unknown error.");
+        }
+    }
+
+    const char *robarma_last_error(void)
+    {
+        return last_error.c_str();
+    }
+}
+
+// end of file
@@ -0,0 +1,65 @@
+#include <Eigen/Dense>
+#include <catch2/catch_test_macros.hpp>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <robarma.h>
+#include <simulate.hpp>
+#include <string>
+#include <vector>
+
+TEST_CASE("C API panel fit", "[c_api]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    phi << 0.5;
+
+    // Three series of different lengths in one caller-owned buffer
+    std::vector<double> values;
+    std::vector<int64_t> offsets;
+    std::vector<int64_t> lengths;
+    for (int i = 0; i < 3; i++)
+    {
+        Eigen::VectorXd y = robarma::simulate(phi, Eigen::VectorXd{}, 1.0, 200 + 50 * i, Eigen::VectorXd{}, 100, 11 + i);
+        offsets.push_back(values.size());
+        lengths.push_back(y.size());
+        values.insert(values.end(), y.data(), y.data() + y.size());
+    }
+
+    robarma_options options;
+    robarma_default_options(&options);
+    options.threads = 2;
+
+    std::vector<double> phi_out(3), mu_out(3);
+    std::vector<uint8_t> convergence(3);
+    robarma_fits out{sizeof(robarma_fits), phi_out.data(), nullptr, mu_out.data(), nullptr, convergence.data(), nullptr, nullptr};
+
+    robarma_status status = robarma_fit_panel(values.data(), offsets.data(), lengths.data(), 3, 1, 0, &options, &out);
+    std::cout << phi_out[0] << " " << phi_out[1] << " " << phi_out[2] << std::endl;
+
+    REQUIRE(status == ROBARMA_OK);
+    for (int i = 0; i < 3; i++)
+    {
+        REQUIRE(convergence[i] == 1);
+        REQUIRE(std::abs(phi_out[i] - 0.5) < 0.3);
+    }
+
+    // A series too short for the model is an invalid argument, rejected before any fit
+    double single_phi = 0.0;
+    robarma_fits single{sizeof(robarma_fits), &single_phi, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr};
+    REQUIRE(robarma_fit(values.data(), 2, 3, 0, nullptr, &single) == ROBARMA_INVALID_ARGUMENT);
+    REQUIRE(std::string(robarma_last_error()).size() > 0);
+
+    std::vector<int64_t> short_lengths{lengths[0], 4, lengths[2]};
+    phi_out.assign(3, -1.0);
+    REQUIRE(robarma_fit_panel(values.data(), offsets.data(), short_lengths.data(), 3, 1, 0, &options, &out) == ROBARMA_INVALID_ARGUMENT);
+    REQUIRE(phi_out[0] == -1.0);
+
+    // Structs of the first version are accepted at their size, anything shorter is not
+    robarma_options first = options;
+    first.size = offsetof(robarma_options, bfgs) + sizeof(int);
+    REQUIRE(robarma_fit(values.data(), lengths[0], 1, 0, &first, &single) == ROBARMA_OK);
+    REQUIRE(std::abs(single_phi - 0.5) < 0.3);
+    first.size = sizeof(size_t);
+    REQUIRE(robarma_fit(values.data(), lengths[0], 1, 0, &first, &single) == ROBARMA_INVALID_ARGUMENT);
+}
@@ -1,16 +1,31 @@
 #include <Eigen/Dense>
+#include <algorithm>
 #include <arma.hpp>
+#include <array>
+#include <batch.hpp>
 #include <bip_s.hpp>
+#include <covariance.hpp>
+#include <diagnostics.hpp>
 #include <catch2/catch_test_macros.hpp>
 #include <ceres/ceres.h>
+#include <columns.hpp>
 #include <estimators.hpp>
+#include <forecast.hpp>
 #include <ftau.hpp>
 #include <iostream>
+#include <metrics.hpp>
 #include <mle.hpp>
 #include <mm.hpp>
+#include <ols.hpp>
+#include <panel.hpp>
+#include <random>
+#include <rho.hpp>
 #include <robust.hpp>
+#include <rolling.hpp>
 #include <s.hpp>
 #include <simulate.hpp>
+#include <sketch.hpp>
+#include <sstream>
 #include <tau.hpp>
 #include <ts.hpp>
 
@@ -61,6 +76,22 @@ TEST_CASE("ARMA HR - 02", "[arma]")
     std::cout << robarma::initial::hannan_rissanen(arma) << std::endl;
 }
 
+TEST_CASE("Levinson-Durbin", "[ts]")
+{
+    Eigen::VectorXd gamma(4);
+    gamma << 2.0, 1.2, 0.5, 0.1;
+
+    Eigen::MatrixXd G(3, 3);
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            G(i, j) = gamma(std::abs(i - j));
+
+    Eigen::VectorXd phi = robarma::levinson_durbin<double>(gamma, 3);
+    Eigen::VectorXd expected = G.ldlt().solve(gamma.tail(3));
+
+    REQUIRE((phi - expected).norm() < 1e-10);
+}
+
 TEST_CASE("ARMA MM - 01", "[arma]")
 {
     Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
@@ -260,4 +291,1095 @@ TEST_CASE("ARMA FTAU - 05", "[arma]")
     robarma::arma_model arma(y, 1, 1);
     robarma::arma_fit fit = robarma::estimators::ftau(arma);
     std::cout << fit << std::endl;
-}
\ No newline at end of file
+}
+
+TEST_CASE("ARMA standard errors", "[covariance]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    phi << 0.6;
+
+    int n = 10000;
+    Eigen::VectorXd y = robarma::simulate(phi, {}, 1, n);
+
+    robarma::arma_model arma(y, 1, 0);
+
+    robarma::arma_fit ols = robarma::estimators::ols(arma);
+    robarma::arma_params se = robarma::standard_errors(ols);
+
+    // Asymptotic standard error of phi in AR(1) is sqrt((1 - phi^2) / n)
+    double expected = std::sqrt((1 - 0.36) / n);
+    REQUIRE(std::abs(se.phi(0) - expected) / expected < 0.1);
+
+    robarma::arma_fit mle = robarma::estimators::mle(arma);
+    Eigen::MatrixXd cov = robarma::covariance(mle);
+    std::cout << cov << std::endl;
+    REQUIRE(cov.llt().info() == Eigen::Success);
+    REQUIRE(std::abs(std::sqrt(cov(0, 0)) - expected) / expected < 0.1);
+
+    // MM is about 95% efficient at the Gaussian model
+    robarma::arma_fit mm = robarma::estimators::mm(arma);
+    cov = robarma::covariance(mm);
+    std::cout << cov << std::endl;
+    REQUIRE(cov.llt().info() == Eigen::Success);
+    REQUIRE(std::abs(std::sqrt(cov(0, 0)) - expected) / expected < 0.15);
+
+    robarma::arma_fit bmm = robarma::estimators::bip_mm(arma);
+    cov = robarma::covariance(bmm);
+    std::cout << cov << std::endl;
+    REQUIRE(cov.llt().info() == Eigen::Success);
+    REQUIRE(std::abs(std::sqrt(cov(0, 0)) - expected) / expected < 0.15);
+
+    // The MM-type sandwiches use the S-estimate of scale the objective was minimized with
+    REQUIRE(std::isfinite(mm.result.scale));
+    REQUIRE(std::isfinite(bmm.result.scale));
+
+    // Fixed parameters are dropped before inverting and reported as NaN
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    Eigen::VectorXd fixed(3);
+    fixed << nan, 0.0, nan;
+    robarma::arma_model arma2(y, 2, 0);
+    robarma::estimation_options masked;
+    masked.fixed = fixed;
+
+    robarma::arma_params se_fixed = robarma::standard_errors(robarma::estimators::ols(arma2, masked), fixed);
+    REQUIRE(std::isnan(se_fixed.phi(1)));
+    REQUIRE(std::abs(se_fixed.phi(0) - expected) / expected < 0.1);
+
+    se_fixed = robarma::standard_errors(robarma::estimators::mle(arma2, masked), fixed);
+    REQUIRE(std::isnan(se_fixed.phi(1)));
+    REQUIRE(std::abs(se_fixed.phi(0) - expected) / expected < 0.1);
+
+    // Unit weights reproduce the unweighted covariance; zero weights on half of the series
+    // leave the information of the other half
+    robarma::arma_model unit(y, 1, 0);
+    unit.set_weights(Eigen::VectorXd::Constant(n, 3.0));
+    REQUIRE((robarma::covariance(robarma::estimators::ols(unit)) - robarma::covariance(ols)).cwiseAbs().maxCoeff() < 1e-12);
+
+    robarma::arma_model half(y, 1, 0);
+    Eigen::VectorXd weights = Eigen::VectorXd::Ones(n);
+    weights.tail(n / 2).setZero();
+    half.set_weights(weights);
+    double ratio = robarma::standard_errors(robarma::estimators::ols(half)).phi(0) / se.phi(0);
+    REQUIRE(std::abs(ratio - std::sqrt(2.0)) < 0.1);
+
+    ratio = robarma::standard_errors(robarma::estimators::mle(half)).phi(0) / std::sqrt(robarma::covariance(mle)(0, 0));
+    REQUIRE(std::abs(ratio - std::sqrt(2.0)) < 0.15);
+}
+
+TEST_CASE("ARMA residual diagnostics", "[diagnostics]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.7;
+    theta << -0.3;
+
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(5000, 0.05, 6);
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 5000, innovations);
+
+    robarma::arma_model arma(y, 1, 1);
+    std::vector<robarma::arma_fit> fits{robarma::estimators::mm(arma), robarma::estimators::ols(arma)};
+
+    robarma::diagnostics::panel_diagnostics d = robarma::diagnostics::diagnose(fits, 10);
+    std::cout << "Ljung-Box p-values: " << d.ljung_box_pvalue.transpose() << std::endl;
+    std::cout << "Flagged fraction: " << d.flagged_fraction.transpose() << std::endl;
+
+    REQUIRE(d.acf.rows() == 2);
+    REQUIRE(d.flagged_fraction(0) > 0.0);
+
+    // More than half of the residuals tied at zero leave the MADN at zero
+    Eigen::VectorXd tied = Eigen::VectorXd::Zero(200);
+    tied.tail(80) = innovations.head(80);
+    robarma::diagnostics::residual_diagnostics r = robarma::diagnostics::diagnose(tied, 10, 2);
+    REQUIRE(r.acf.allFinite());
+    REQUIRE(std::isfinite(r.ljung_box));
+
+    // The null variances reduce to the classical 6 and 24 without truncation, and Gaussian
+    // residuals are rejected at about the nominal rate
+    std::array<double, 2> variances = robarma::diagnostics::detail::jarque_bera_variances(100.0);
+    REQUIRE(std::abs(variances[0] - 6.0) < 1e-9);
+    REQUIRE(std::abs(variances[1] - 24.0) < 1e-9);
+
+    std::mt19937 rng(7);
+    std::normal_distribution<double> normal;
+    int rejected = 0;
+    for (int rep = 0; rep < 400; rep++)
+    {
+        Eigen::VectorXd e(1000);
+        for (int i = 0; i < e.size(); i++)
+            e(i) = normal(rng);
+        rejected += robarma::diagnostics::diagnose(e, 10, 2).jarque_bera_pvalue < 0.1;
+    }
+    REQUIRE(rejected > 20);
+    REQUIRE(rejected < 60);
+}
+
+TEST_CASE("ARMA model view", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.6;
+    theta << 0.3;
+
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(500, 0.05, 6, 3);
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 1, 500, innovations, 100, 3);
+
+    // The view maps the caller's values, and copies of a model share its series
+    robarma::arma_model view = robarma::arma_model::view(Eigen::Map<const Eigen::VectorXd>(y.data(), y.size()), 1, 1);
+    robarma::arma_model copy = view;
+    REQUIRE(view.is_view());
+    REQUIRE(view.y.data() == y.data());
+    REQUIRE(copy.y.data() == y.data());
+
+    robarma::arma_model owned(y, 1, 1);
+    robarma::arma_model owned_copy = owned;
+    REQUIRE(!owned.is_view());
+    REQUIRE(owned.y.data() != y.data());
+    REQUIRE(owned_copy.y.data() == owned.y.data());
+    REQUIRE(view.mu == owned.mu);
+    REQUIRE(view.sigma == owned.sigma);
+
+    robarma::arma_fit fit_view = robarma::estimators::s(view);
+    robarma::arma_fit fit_owned = robarma::estimators::s(owned);
+    REQUIRE((fit_view.params.phi - fit_owned.params.phi).norm() == 0.0);
+    REQUIRE(fit_view.params.mu == fit_owned.params.mu);
+}
+
+TEST_CASE("ARMA Robust-YW - 01", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.7;
+    theta << 0.5;
+
+    std::vector<robarma::arma_model> models;
+    for (int i = 0; i < 4; i++)
+    {
+        Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(10000, 0.02, 6, i + 1);
+        models.emplace_back(robarma::simulate(phi, theta, 1, 10000, innovations, 100, i + 1), 1, 1);
+    }
+
+    std::vector<robarma::arma_fit> fits = robarma::estimators::robust_yw(models);
+    for (const robarma::arma_fit &fit : fits)
+    {
+        std::cout << fit << std::endl;
+        REQUIRE(std::abs(fit.params.phi(0) - 0.7) < 0.1);
+    }
+}
+
+TEST_CASE("ARMA MM coarse-to-fine", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(2);
+
+    phi << 0.7;
+    theta << 0.2, -0.4;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 50000);
+
+    robarma::arma_model arma(y, 1, 2);
+
+    robarma::estimation_options options;
+    options.coarse_to_fine.enabled = true;
+    options.coarse_to_fine.sizes = {2000, 10000};
+
+    robarma::arma_fit fit = robarma::estimators::mm(arma, options);
+    std::cout << fit << std::endl;
+
+    REQUIRE(fit.result.subsample_evaluations > 0.0);
+}
+
+TEST_CASE("ARMA MLE BFGS backend", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.8;
+    theta << -0.7;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 500);
+
+    robarma::arma_model arma(y, 1, 1);
+
+    robarma::estimation_options options;
+    options.backend = robarma::solver_backend::bfgs;
+
+    robarma::arma_fit fit = robarma::estimators::mle(arma, options);
+    REQUIRE(fit.result.report.empty());
+
+    options.report = true;
+    robarma::arma_fit reported = robarma::estimators::mle(arma, options);
+    std::cout << reported << std::endl;
+    std::cout << reported.result.report << std::endl;
+
+    REQUIRE(reported.result.evaluations > 0);
+    REQUIRE(!reported.result.report.empty());
+}
+
+TEST_CASE("ARMA BIP-MM IRLS", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.8;
+    theta << -0.7;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 500);
+
+    robarma::arma_model arma(y, 1, 1);
+
+    robarma::arma_fit fit = robarma::estimators::bip_mm(arma);
+    std::cout << fit << std::endl;
+    std::cout << fit.result.report << std::endl;
+
+    robarma::estimation_options options;
+    options.irls = false;
+    options.backend = robarma::solver_backend::bfgs;
+
+    robarma::arma_fit reference = robarma::estimators::bip_mm(arma, options);
+    std::cout << reference << std::endl;
+
+    REQUIRE(fit.result.convergence);
+    REQUIRE(std::abs(fit.params.phi(0) - reference.params.phi(0)) < 1e-2);
+    REQUIRE(std::abs(fit.params.theta(0) - reference.params.theta(0)) < 1e-2);
+    REQUIRE(fit.result.final_cost <= reference.result.final_cost * (1.0 + 1e-4));
+
+    // A step that cannot decrease the objective away from the optimum is not convergence
+    Eigen::VectorXd beta = Eigen::VectorXd::Zero(1);
+    auto ascent = [&](const Eigen::VectorXd &b, Eigen::MatrixXd &J)
+    {
+        J = Eigen::MatrixXd::Ones(y.size(), 1);
+        return Eigen::VectorXd(y.array() - b(0) - 5.0);
+    };
+    robarma::irls::summary summary = robarma::irls::minimize(ascent, 1.0, beta);
+    std::cout << summary.report() << std::endl;
+    REQUIRE(!summary.convergence);
+}
+
+TEST_CASE("ARMA BIP residuals", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(2);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(2);
+
+    phi << 0.5, -0.3;
+    theta << 0.4, 0.2;
+
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(400, 0.05, 8, 5);
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 1.0, 400, innovations);
+    robarma::arma_model arma(y, 2, 2);
+
+    double mu = 0.8;
+    double sigma = 1.3;
+
+    // Direct recursion passing the whole p- and q-windows through eta at every step
+    Eigen::VectorXd reference = Eigen::VectorXd::Zero(arma.n);
+    for (int i = arma.r; i < arma.n; i++)
+    {
+        // p = q = 2, so both windows hold the last two residuals
+        Eigen::VectorXd lags = reference.segment(i - 2, 2).reverse();
+        Eigen::VectorXd cleaned = sigma * robarma::bip::eta(Eigen::VectorXd(lags / sigma)).array();
+        double ar = phi.dot(Eigen::VectorXd(y.segment(i - 2, 2).reverse()) - lags);
+        double rq = theta.dot(cleaned);
+        double rp = phi.dot(cleaned);
+        reference(i) = y(i) - mu * (1.0 - phi.sum()) - ar - rq - rp;
+    }
+
+    Eigen::VectorXd e = arma.bip_arma_residuals<double>(phi, theta, mu, sigma);
+    Eigen::MatrixXd J;
+    Eigen::VectorXd e_J = arma.bip_arma_residuals(phi, theta, mu, sigma, J);
+
+    REQUIRE((e - reference).cwiseAbs().maxCoeff() < 1e-12);
+    REQUIRE((e_J - reference).cwiseAbs().maxCoeff() < 1e-12);
+}
+
+TEST_CASE("ARMA concentrated mu", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.6;
+    theta << 0.3;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 2.0, 500);
+
+    robarma::arma_model arma(y, 1, 1);
+
+    robarma::estimation_options options;
+    options.concentrate_mu = true;
+
+    robarma::arma_fit fit_ols = robarma::estimators::ols(arma, options);
+    std::cout << fit_ols << std::endl;
+
+    robarma::arma_fit fit_s = robarma::estimators::s(arma, options);
+    std::cout << fit_s << std::endl;
+
+    REQUIRE(std::abs(fit_ols.params.mu - arma.gls_location(fit_ols.params.phi, fit_ols.params.theta)) < 1e-10);
+
+    // MM and BIP-MM run IRLS by default, which must not bypass the profiled location
+    robarma::arma_fit fit_mm = robarma::estimators::mm(arma, options);
+    std::cout << fit_mm << std::endl;
+    REQUIRE(std::abs(fit_mm.params.mu - robarma::profile::robust_location(arma, fit_mm.params.phi, fit_mm.params.theta)) < 1e-10);
+
+    robarma::arma_fit fit_bmm = robarma::estimators::bip_mm(arma, options);
+    std::cout << fit_bmm << std::endl;
+    REQUIRE(std::abs(fit_bmm.params.mu - robarma::profile::robust_location(arma, fit_bmm.params.phi, fit_bmm.params.theta)) < 1e-10);
+}
+
+TEST_CASE("ARMA fixed parameters", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.6;
+    theta << 0.3;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 500);
+
+    robarma::arma_model arma(y, 2, 1);
+
+    // Estimate phi_1 and theta_1, with phi_2 and mu fixed at zero
+    double nan = std::numeric_limits<double>::quiet_NaN();
+    robarma::estimation_options options;
+    options.fixed = Eigen::VectorXd(4);
+    options.fixed << nan, 0.0, nan, 0.0;
+
+    robarma::arma_fit fit_mle = robarma::estimators::mle(arma, options);
+    std::cout << fit_mle << std::endl;
+
+    robarma::arma_fit fit_mm = robarma::estimators::mm(arma, options);
+    std::cout << fit_mm << std::endl;
+
+    REQUIRE(fit_mle.params.phi(1) == 0.0);
+    REQUIRE(fit_mm.params.mu == 0.0);
+
+    // Masked BFGS solves take the line search limit of the Ceres options, as the fallback
+    // ladder's evaluation budget relies on: at most one trial per iteration here
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(500, 0.1, 5, 3);
+    robarma::arma_model arma11(robarma::simulate(Eigen::VectorXd::Constant(1, 0.8), Eigen::VectorXd::Constant(1, -0.7), 0, 500, innovations), 1, 1);
+    robarma::arma_params start(Eigen::VectorXd::Constant(1, -0.9), Eigen::VectorXd::Constant(1, -0.95), 0.0);
+    robarma::arma_fit initial(arma11, start, robarma::estimation_result(robarma::estimation_method::s, true, 0.0));
+    Eigen::VectorXd fixed_mu(3);
+    fixed_mu << nan, nan, 0.0;
+    robarma::mask::layout layout(arma11, fixed_mu, start);
+
+    ceres::Solver::Options ceres_options;
+    ceres_options.max_num_iterations = 3;
+    ceres_options.max_num_line_search_step_size_iterations = 1;
+    robarma::arma_fit masked = robarma::solver::solve_masked(arma11, initial, robarma::estimation_method::s, new robarma::s::cost<>(arma11), layout, ceres_options, robarma::solver_backend::bfgs);
+    REQUIRE(masked.result.evaluations <= 1 + 2 * masked.result.iterations);
+}
+
+TEST_CASE("ARMA fallback ladder", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.8;
+    theta << -0.7;
+
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(500, 0.1, 5);
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 500, innovations);
+
+    robarma::arma_model arma(y, 1, 1);
+
+    robarma::estimation_options options;
+    options.fallback.enabled = true;
+    options.fallback.max_evaluations = 500;
+
+    robarma::arma_fit fit = robarma::estimators::ftau(arma, options);
+    std::cout << fit << std::endl;
+
+    REQUIRE(!fit.result.attempts.empty());
+    REQUIRE(fit.result.attempts.front().strategy == "initial");
+
+    // An explosive MA start leaves the first solve with a non-finite cost
+    options.backend = robarma::solver_backend::bfgs;
+    options.start = Eigen::VectorXd(3);
+    options.start << 0.5, 50.0, 0.0;
+
+    // The ladder is off by default: the failed solve is returned without retries
+    robarma::estimation_options defaults;
+    defaults.backend = options.backend;
+    defaults.start = options.start;
+    REQUIRE(!robarma::estimation_options{}.fallback.enabled);
+    robarma::arma_fit failed = robarma::estimators::s(arma, defaults);
+    REQUIRE(failed.result.attempts.size() == 1);
+    REQUIRE(!failed.result.convergence);
+
+    for (int budget : {1000, 40})
+    {
+        options.fallback.max_evaluations = budget;
+        robarma::arma_fit retried = robarma::estimators::s(arma, options);
+
+        int evaluations = 0;
+        for (const robarma::estimation_attempt &attempt : retried.result.attempts)
+        {
+            std::cout << attempt.strategy << ": " << attempt.convergence << " " << attempt.final_cost << " " << attempt.evaluations << std::endl;
+            evaluations += attempt.evaluations;
+        }
+
+        REQUIRE(retried.result.attempts.size() >= 2);
+        REQUIRE(!retried.result.attempts.front().convergence);
+        REQUIRE(retried.result.attempts[1].strategy == "robust start");
+        REQUIRE(std::isfinite(retried.result.final_cost));
+        REQUIRE(evaluations <= budget);
+    }
+}
+
+TEST_CASE("ARMA auto fit", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.8;
+    theta << -0.3;
+
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(500, 0.05, 8, 11);
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 500, innovations);
+
+    robarma::arma_model arma(y, 1, 1);
+
+    robarma::arma_fit fit = robarma::estimators::auto_fit(arma);
+    std::cout << fit << std::endl;
+    std::cout << "scale ratio " << fit.screen->scale_ratio << ", flagged " << fit.screen->flagged_fraction << std::endl;
+
+    REQUIRE(fit.screen.has_value());
+    REQUIRE(fit.screen->contaminated);
+
+    // Gaussian innovations select the classical estimator
+    Eigen::VectorXd clean = robarma::simulate(phi, theta, 0, 1000, robarma::sample_normal(1000, 0.0, 1.0, 11));
+    robarma::arma_model clean_arma(clean, 1, 1);
+
+    robarma::arma_fit clean_fit = robarma::estimators::auto_fit(clean_arma);
+    std::cout << "scale ratio " << clean_fit.screen->scale_ratio << ", flagged " << clean_fit.screen->flagged_fraction << std::endl;
+
+    REQUIRE(clean_fit.screen.has_value());
+    REQUIRE(!clean_fit.screen->contaminated);
+    REQUIRE(clean_fit.screen->selected == robarma::selection_options{}.classical);
+    REQUIRE(clean_fit.result.method == robarma::selection_options{}.classical);
+}
+
+TEST_CASE("ARMA rho families", "[arma]")
+{
+    using bisquare95 = robarma::rho::bisquare<std::ratio<4685, 1000>>;
+    static_assert(bisquare95::efficiency() > 0.94 && bisquare95::efficiency() < 0.96, "bisquare with k = 4.685 has 95% efficiency");
+
+    std::cout << "efficiency: rho2 " << robarma::bip::rho2_family::efficiency() << ", bisquare " << bisquare95::efficiency()
+              << ", huber " << robarma::rho::huber<>::efficiency() << std::endl;
+
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.6;
+    theta << 0.3;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 500);
+
+    robarma::arma_model arma(y, 1, 1);
+
+    robarma::arma_fit fit_default = robarma::estimators::mm(arma);
+    std::cout << fit_default << std::endl;
+
+    robarma::arma_fit fit = robarma::estimators::mm<robarma::rho::bisquare<>, bisquare95>(arma);
+    std::cout << fit << std::endl;
+
+    REQUIRE(std::abs(robarma::bip::rho2(2.5) - robarma::rho::optimal<>::rho(2.5)) == 0.0);
+    REQUIRE(std::abs(fit.params.phi(0) - fit_default.params.phi(0)) < 0.1);
+}
+
+TEST_CASE("ARMA high order", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(2);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.5, -0.2;
+    theta << 0.3;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0, 2000);
+
+    robarma::arma_model arma(y, 30, 1);
+
+    robarma::arma_fit fit = robarma::estimators::ols(arma);
+    std::cout << fit << std::endl;
+
+    REQUIRE(std::abs(fit.params.phi(0) + fit.params.theta(0) - 0.8) < 0.15);
+
+    // The tiled residual recursion and its sensitivities match the plain per-step recursion
+    // over several tiles
+    Eigen::VectorXd phi3(3);
+    Eigen::VectorXd theta2(2);
+    phi3 << 0.4, -0.3, 0.2;
+    theta2 << 0.5, -0.25;
+    double mu = 0.7;
+    robarma::arma_model model(Eigen::VectorXd(y.head(700)), 3, 2);
+    int n = model.n;
+    int r = model.r;
+
+    Eigen::VectorXd e = Eigen::VectorXd::Zero(n);
+    Eigen::MatrixXd J = Eigen::MatrixXd::Zero(n, 6);
+    for (int t = r; t < n; t++)
+    {
+        e(t) = model.y(t) - mu;
+        for (int j = 0; j < 3; j++)
+        {
+            e(t) -= phi3(j) * (model.y(t - j - 1) - mu);
+            J(t, j) = -(model.y(t - j - 1) - mu);
+        }
+        for (int j = 0; j < 2; j++)
+        {
+            e(t) -= theta2(j) * e(t - j - 1);
+            J(t, 3 + j) = -e(t - j - 1);
+        }
+        J(t, 5) = -(1.0 - phi3.sum());
+        for (int k = 0; k < 2; k++)
+            J.row(t) -= theta2(k) * J.row(t - k - 1);
+    }
+
+    Eigen::MatrixXd J_tiled;
+    Eigen::VectorXd e_tiled = model.arma_residuals(phi3, theta2, mu, J_tiled);
+    REQUIRE((model.arma_residuals<double>(phi3, theta2, mu) - e).cwiseAbs().maxCoeff() < 1e-12);
+    REQUIRE((e_tiled - e).cwiseAbs().maxCoeff() < 1e-12);
+    REQUIRE((J_tiled - J).cwiseAbs().maxCoeff() < 1e-12);
+
+    // The companion prediction step matches the dense F P F' + s2 H H' update
+    robarma::arma_model order(y, 4, 4);
+    robarma::state_space_cost space(order);
+    Eigen::VectorXd phi4(4);
+    Eigen::VectorXd theta4(4);
+    phi4 << 0.3, -0.2, 0.1, 0.05;
+    theta4 << 0.4, 0.2, -0.1, 0.3;
+
+    Eigen::MatrixXd F = space.F0<double>(phi4);
+    Eigen::VectorXd H = space.H0<double>(theta4);
+    Eigen::VectorXd c = space.c0<double>(phi4, mu);
+    Eigen::MatrixXd A = Eigen::MatrixXd::Random(5, 5);
+    Eigen::MatrixXd P = A * A.transpose();
+    Eigen::VectorXd a = Eigen::VectorXd::Random(5);
+
+    Eigen::VectorXd a_dense = F * a + c;
+    Eigen::MatrixXd P_dense = F * P * F.transpose() + 1.5 * H * H.transpose();
+    space.companion_predict<double>(a, P, space.phi0<double>(phi4), H, 1.5, c);
+    REQUIRE((a - a_dense).cwiseAbs().maxCoeff() < 1e-12);
+    REQUIRE((P - P_dense).cwiseAbs().maxCoeff() < 1e-12);
+}
+
+TEST_CASE("ARMA MLE exact MA likelihood", "[arma]")
+{
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(2);
+
+    theta << -0.4, 0.8;
+
+    Eigen::VectorXd y = robarma::simulate({}, theta, 1, 12);
+
+    robarma::arma_model arma(y, 0, 2);
+    robarma::mle::cost cost(arma);
+
+    Eigen::VectorXd w, f;
+    cost.filter<double>(Eigen::VectorXd(0), theta, 1.0, w, f);
+
+    // Dense covariance of the MA(2) process in units of sigma^2
+    int n = y.size();
+    Eigen::VectorXd psi(3);
+    psi << 1.0, theta;
+    Eigen::MatrixXd G = Eigen::MatrixXd::Zero(n, n);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            if (std::abs(i - j) <= 2)
+                G(i, j) = psi.head(3 - std::abs(i - j)).dot(psi.tail(3 - std::abs(i - j)));
+
+    Eigen::VectorXd yc = y.array() - 1.0;
+    double quadratic = yc.dot(G.ldlt().solve(yc));
+
+    REQUIRE(std::abs(w.squaredNorm() - quadratic) < 1e-8);
+    REQUIRE(std::abs(f.array().log().sum() - std::log(G.determinant())) < 1e-8);
+}
+
+TEST_CASE("ARMA MLE exact AR likelihood", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(2);
+
+    phi << 0.6, -0.3;
+
+    Eigen::VectorXd y = robarma::simulate(phi, {}, 1, 15);
+
+    robarma::arma_model arma(y, 2, 0);
+    robarma::mle::cost cost(arma);
+
+    double loss;
+    REQUIRE(cost.ar_loss<double>(phi, 1.0, loss));
+
+    // Dense covariance of the AR(2) process in units of sigma^2, from its causal weights
+    int n = y.size();
+    int m = 500;
+    Eigen::VectorXd psi = Eigen::VectorXd::Zero(m);
+    psi(0) = 1.0;
+    for (int i = 1; i < m; i++)
+        for (int j = 1; j <= 2 && j <= i; j++)
+            psi(i) += phi(j - 1) * psi(i - j);
+
+    Eigen::MatrixXd G(n, n);
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            G(i, j) = psi.head(m - std::abs(i - j)).dot(psi.tail(m - std::abs(i - j)));
+
+    Eigen::VectorXd yc = y.array() - 1.0;
+    double dense = n * std::log(yc.dot(G.ldlt().solve(yc))) + std::log(G.determinant());
+
+    REQUIRE(std::abs(loss - dense) < 1e-8);
+}
+
+TEST_CASE("ARMA OLS AR moments", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(3);
+
+    phi << 0.7, -0.5, 0.4;
+
+    Eigen::VectorXd y = robarma::simulate(phi, {}, 3, 2000);
+
+    // Lag products shared by all orders up to 3
+    robarma::lag_products products(y, 3);
+
+    for (int p = 1; p <= 3; p++)
+    {
+        robarma::arma_model arma(y, p, 0);
+        robarma::ols::cost cost(arma, products);
+
+        Eigen::VectorXd phi_p = phi.head(p);
+        Eigen::VectorXd theta = Eigen::VectorXd::Zero(0);
+        double mu = 2.5;
+        const double *parameters[] = {phi_p.data(), theta.data(), &mu};
+
+        double value;
+        cost(parameters, &value);
+
+        double direct = arma.arma_residuals<double>(phi_p, theta, mu).squaredNorm();
+        REQUIRE(std::abs(value - direct) < 1e-8 * direct);
+    }
+
+    robarma::arma_model arma(y, 3, 0);
+    robarma::arma_fit fit = robarma::estimators::ols(arma);
+    std::cout << fit << std::endl;
+}
+
+TEST_CASE("ARMA forecast intervals", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.6;
+    theta << 0.3;
+
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(1000, 0.05, 8);
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 2.0, 1000, innovations);
+
+    robarma::arma_model arma(Eigen::VectorXd(y.head(900)), 1, 1);
+    robarma::arma_fit fit = robarma::estimators::mm(arma);
+
+    REQUIRE(fit.residual_quantiles.has_value());
+    REQUIRE(fit.residual_quantiles->count() == arma.n - arma.r);
+
+    // Without keep_residuals only the sketch is cached
+    robarma::estimation_options lean;
+    lean.keep_residuals = false;
+    robarma::arma_fit fit_lean = robarma::estimators::mm(arma, lean);
+    REQUIRE(!fit_lean.residuals.has_value());
+    REQUIRE(fit_lean.residual_quantiles->count() == arma.n - arma.r);
+
+    // BIP-MM caches the residuals of its own recursion
+    robarma::arma_fit s_bmm = robarma::estimators::bip_s(arma);
+    double sigma = s_bmm.result.final_cost;
+    robarma::arma_fit fit_bmm = robarma::bmm::bmm(arma, sigma, s_bmm);
+    Eigen::VectorXd e_bmm = arma.bip_arma_residuals(fit_bmm.params.phi, fit_bmm.params.theta, fit_bmm.params.mu, sigma);
+    REQUIRE((*fit_bmm.residuals - e_bmm).cwiseAbs().maxCoeff() < 1e-12);
+
+    // Stream the held-out observations through the filter, then forecast
+    robarma::arma_filter filter(fit);
+    Eigen::VectorXd streamed(100);
+    for (int t = 900; t < 1000; t++)
+        streamed(t - 900) = filter.update(y(t));
+
+    // The filter continues the residual recursion of the concatenated series
+    robarma::arma_model full(y, 1, 1);
+    Eigen::VectorXd e = full.arma_residuals(fit.params.phi, fit.params.theta, fit.params.mu);
+    REQUIRE((streamed - e.tail(100)).cwiseAbs().maxCoeff() < 1e-9);
+
+    robarma::forecast_result forecast = filter.forecast(5, 0.9);
+    std::cout << forecast.lower.transpose() << "\n"
+              << forecast.mean.transpose() << "\n"
+              << forecast.upper.transpose() << std::endl;
+
+    REQUIRE(filter.residual_quantiles().count() == arma.n - arma.r + 100);
+    REQUIRE((forecast.lower.array() < forecast.mean.array()).all());
+    REQUIRE((forecast.upper.array() > forecast.mean.array()).all());
+}
+
+TEST_CASE("KLL quantile sketch", "[robust]")
+{
+    int n = 20000;
+    Eigen::VectorXd x = robarma::generate_innovations_with_outliers(n, 0.05, 10, 3);
+    std::vector<double> sorted(x.data(), x.data() + n);
+    std::sort(sorted.begin(), sorted.end());
+
+    // Fraction of the values not exceeding v
+    auto exact_rank = [&](double v)
+    {
+        return double(std::upper_bound(sorted.begin(), sorted.end(), v) - sorted.begin()) / n;
+    };
+
+    robarma::sketch::kll whole;
+    robarma::sketch::kll first;
+    robarma::sketch::kll second;
+    for (int t = 0; t < n; t++)
+    {
+        whole.insert(x(t));
+        (t < n / 2 ? first : second).insert(x(t));
+    }
+    first.merge(second);
+
+    REQUIRE(whole.count() == n);
+    REQUIRE(first.count() == n);
+    REQUIRE(whole.retained() < n / 10);
+    REQUIRE(first.retained() < n / 10);
+
+    // Rank error of order 1 / k = 0.005 for the default k = 200
+    for (double q : {0.01, 0.05, 0.25, 0.5, 0.75, 0.95, 0.99})
+    {
+        std::cout << q << ": " << whole.quantile(q) << " " << first.quantile(q) << " " << sorted[int(q * (n - 1))] << std::endl;
+        REQUIRE(std::abs(exact_rank(whole.quantile(q)) - q) < 0.02);
+        REQUIRE(std::abs(exact_rank(first.quantile(q)) - q) < 0.02);
+
+        double v = sorted[int(q * (n - 1))];
+        REQUIRE(std::abs(whole.rank(v) - exact_rank(v)) < 0.02);
+        REQUIRE(std::abs(first.rank(v) - exact_rank(v)) < 0.02);
+    }
+}
+
+TEST_CASE("Rolling robust statistics", "[robust]")
+{
+    Eigen::VectorXd y = robarma::generate_innovations_with_outliers(600, 0.05, 10);
+
+    int w = 60;
+    Eigen::VectorXd median = robarma::rolling::median(y, w);
+    Eigen::VectorXd madn = robarma::rolling::MADN(y, w);
+    Eigen::VectorXd scale = robarma::rolling::scale(y, w);
+
+    REQUIRE(median.size() == y.size() - w + 1);
+    for (int i = 0; i < median.size(); i += 50)
+    {
+        Eigen::VectorXd window = y.segment(i, w);
+        double center = robarma::base::median(window);
+        double reference = robarma::base::scale<double>(Eigen::VectorXd(window.array() - center));
+
+        REQUIRE(median(i) == center);
+        REQUIRE(std::abs(madn(i) - robarma::base::MADN(window)) < 1e-12);
+        REQUIRE(std::abs(scale(i) - reference) < 1e-4 * reference);
+    }
+
+    // Streaming one value at a time matches the batch statistics at every step, ties included
+    Eigen::VectorXd tied = y.array().round();
+    Eigen::VectorXd tied_median = robarma::rolling::median(tied, w);
+    robarma::rolling::order_statistics window(w);
+    for (int t = 0; t < y.size(); t++)
+    {
+        window.push(y(t));
+        REQUIRE(window.size() == std::min(t + 1, w));
+        if (!window.full())
+            continue;
+        REQUIRE(window.median() == median(t - w + 1));
+        REQUIRE(window.mad() / 0.675 == madn(t - w + 1));
+    }
+
+    robarma::rolling::order_statistics rounded(w);
+    for (int t = 0; t < tied.size(); t++)
+    {
+        rounded.push(tied(t));
+        if (rounded.full())
+        {
+            Eigen::VectorXd segment = tied.segment(t - w + 1, w);
+            REQUIRE(rounded.median() == tied_median(t - w + 1));
+            REQUIRE(rounded.median() == robarma::base::median(segment));
+            REQUIRE(std::abs(rounded.mad() / 0.675 - robarma::base::MADN(segment)) < 1e-12);
+        }
+    }
+}
+
+TEST_CASE("ARMA observation weights", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.5;
+    theta << 0.2;
+
+    Eigen::VectorXd innovations = robarma::generate_innovations_with_outliers(600, 0.05, 8, 4);
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 1.0, 600, innovations);
+
+    robarma::arma_model plain(y, 1, 1);
+    robarma::arma_model unit(y, 1, 1);
+    unit.set_weights(Eigen::VectorXd::Constant(600, 3.0));
+
+    // Unit weights after normalization reproduce the unweighted objectives
+    double beta[] = {0.4, 0.1, 0.9};
+    const double *const parameters[] = {beta, beta + 1, beta + 2};
+    auto invariant = [&](auto make_cost)
+    {
+        double value_plain = 0.0;
+        double value_unit = 0.0;
+        make_cost(plain)(parameters, &value_plain);
+        make_cost(unit)(parameters, &value_unit);
+        REQUIRE(std::isfinite(value_plain));
+        REQUIRE(std::abs(value_plain - value_unit) < 1e-10 * std::abs(value_plain));
+    };
+    invariant([](const robarma::arma_model &m)
+              { return robarma::mm::cost<>(m, m.sigma); });
+    invariant([](const robarma::arma_model &m)
+              { return robarma::s::cost<>(m); });
+    invariant([](const robarma::arma_model &m)
+              { return robarma::estimators::bip_s_functor<>(m); });
+    invariant([](const robarma::arma_model &m)
+              { return robarma::ftau::cost<>(m); });
+    invariant([](const robarma::arma_model &m)
+              { return robarma::ols::cost(m); });
+    invariant([](const robarma::arma_model &m)
+              { return robarma::mle::cost(m); });
+
+    // Zero weight on the last block equals fitting the series without it
+    Eigen::VectorXd head_weights = Eigen::VectorXd::Ones(600);
+    head_weights.tail(100).setZero();
+    robarma::arma_model truncated(y, 1, 1);
+    truncated.set_weights(head_weights);
+    robarma::arma_model head(Eigen::VectorXd(y.head(500)), 1, 1);
+
+    // The OLS objectives agree up to a positive factor, so they share their minimizer
+    double other[] = {0.6, -0.2, 1.2};
+    const double *const other_parameters[] = {other, other + 1, other + 2};
+    auto cost_ratio = [&](auto make_cost)
+    {
+        double t1 = 0.0, t2 = 0.0, h1 = 0.0, h2 = 0.0;
+        make_cost(truncated)(parameters, &t1);
+        make_cost(truncated)(other_parameters, &t2);
+        make_cost(head)(parameters, &h1);
+        make_cost(head)(other_parameters, &h2);
+        return (t1 - t2) / (h1 - h2);
+    };
+    double ols_ratio = cost_ratio([](const robarma::arma_model &m)
+                                      { return robarma::ols::cost(m); });
+    REQUIRE(std::abs(ols_ratio - 1.2) < 1e-10);
+
+    // Both fits reach the same minimum of the weighted objective
+    robarma::estimation_options bfgs;
+    bfgs.backend = robarma::solver_backend::bfgs;
+    robarma::arma_fit fit_truncated = robarma::estimators::ols(truncated, bfgs);
+    robarma::arma_fit fit_head = robarma::estimators::ols(head, bfgs);
+    double head_beta[] = {fit_head.params.phi(0), fit_head.params.theta(0), fit_head.params.mu};
+    const double *const head_parameters[] = {head_beta, head_beta + 1, head_beta + 2};
+    double at_head = 0.0;
+    robarma::ols::cost{truncated}(head_parameters, &at_head);
+    std::cout << fit_truncated.params.phi(0) << " " << fit_head.params.phi(0) << std::endl;
+    REQUIRE(std::abs(at_head - fit_truncated.result.final_cost) < 1e-5 * fit_truncated.result.final_cost);
+
+    // The profiled mu minimizes the weighted objective
+    robarma::arma_model forgotten(y, 1, 1);
+    forgotten.set_weights(robarma::exponential_weights(600, 0.99));
+    Eigen::VectorXd phi0 = Eigen::VectorXd::Constant(1, 0.4);
+    Eigen::VectorXd theta0 = Eigen::VectorXd::Constant(1, 0.1);
+    double mu0 = forgotten.gls_location(phi0, theta0);
+    auto ols_cost = [&](double mu)
+    {
+        double b[] = {0.4, 0.1, mu};
+        const double *const blocks[] = {b, b + 1, b + 2};
+        double value = 0.0;
+        const robarma::ols::cost cost{forgotten};
+        cost(blocks, &value);
+        return value;
+    };
+    REQUIRE(ols_cost(mu0) < ols_cost(mu0 + 1e-3));
+    REQUIRE(ols_cost(mu0) < ols_cost(mu0 - 1e-3));
+
+    robarma::arma_model forgetting(y, 1, 1);
+    forgetting.set_weights(robarma::exponential_weights(600, 0.995));
+    robarma::arma_fit fit = robarma::estimators::mm(forgetting);
+    std::cout << fit << std::endl;
+
+    REQUIRE(std::abs(forgetting.weights.mean() - 1.0) < 1e-12);
+    REQUIRE(std::abs(fit.params.phi(0) - 0.5) < 0.3);
+}
+
+TEST_CASE("ARMA series panel", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.5;
+    theta << 0.3;
+
+    robarma::series_panel panel = robarma::simulate_panel(phi, theta, 1.0, 250, 6, 100, 42, 4);
+
+    REQUIRE(panel.size() == 6);
+    for (int i = 0; i < panel.size(); i++)
+    {
+        Eigen::VectorXd y = robarma::simulate(phi, theta, 1.0, 250, Eigen::VectorXd{}, 100, 42 + i);
+        REQUIRE(panel.offset(i) % 4 == 0);
+        REQUIRE(panel.series(i) == y);
+        REQUIRE(panel.location(i) == robarma::base::median(y));
+    }
+
+    // Round trip through the binary format
+    std::stringstream file;
+    panel.write(file);
+    robarma::series_panel copy = robarma::series_panel::read(file);
+    REQUIRE(copy.size() == panel.size());
+    REQUIRE(copy.series(5) == panel.series(5));
+    REQUIRE(copy.scale(5) == panel.scale(5));
+
+    // Files with inconsistent columns are rejected before anything is indexed
+    auto crafted = [](std::int64_t lanes, std::vector<std::int64_t> offsets, std::vector<std::int64_t> lengths, std::size_t values)
+    {
+        std::stringstream out;
+        robarma::io::writer writer(out, robarma::io::kind::panel, 6);
+        std::vector<double> stats(lengths.size(), 1.0);
+        writer.column(&lanes, 1);
+        writer.column(offsets);
+        writer.column(lengths);
+        writer.column(stats);
+        writer.column(stats);
+        writer.column(std::vector<double>(values, 0.0));
+        return out;
+    };
+    std::stringstream valid = crafted(2, {0, 4, 8}, {3, 4}, 8);
+    REQUIRE(robarma::series_panel::read(valid).length(1) == 4);
+    std::stringstream shifted = crafted(2, {2, 4, 8}, {2, 4}, 8);
+    REQUIRE_THROWS_AS(robarma::series_panel::read(shifted), std::runtime_error);
+    std::stringstream negative = crafted(2, {0, 4, 8}, {-1, 4}, 8);
+    REQUIRE_THROWS_AS(robarma::series_panel::read(negative), std::runtime_error);
+    std::stringstream decreasing = crafted(1, {0, 6, 4, 8}, {1, 1, 4}, 8);
+    REQUIRE_THROWS_AS(robarma::series_panel::read(decreasing), std::runtime_error);
+    std::stringstream unaligned = crafted(2, {0, 3, 8}, {3, 4}, 8);
+    REQUIRE_THROWS_AS(robarma::series_panel::read(unaligned), std::runtime_error);
+
+    // A column count beyond the end of the file fails without allocating it
+    std::stringstream truncated;
+    panel.write(truncated);
+    std::string bytes = truncated.str();
+    std::uint64_t huge = std::uint64_t(1) << 60;
+    std::size_t count_at = 24 + 24 + 8; // header, lanes column, type tag and size of the offsets
+    bytes.replace(count_at, sizeof(huge), reinterpret_cast<const char *>(&huge), sizeof(huge));
+    std::stringstream oversized(bytes);
+    REQUIRE_THROWS_AS(robarma::series_panel::read(oversized), std::runtime_error);
+
+    // The thread pool gives the same fits as the sequential estimator
+    std::vector<robarma::arma_params> params = robarma::batch::fit(panel, 1, 1, robarma::estimation_method::mm, {}, 3);
+    for (int i = 0; i < panel.size(); i++)
+    {
+        robarma::arma_model model = panel.model(i, 1, 1);
+        REQUIRE(model.y.data() == panel.series(i).data());
+        robarma::arma_fit fit = robarma::estimators::mm(model);
+        std::cout << params[i].phi(0) << " " << params[i].theta(0) << " " << params[i].mu << std::endl;
+        REQUIRE(std::abs(params[i].phi(0) - fit.params.phi(0)) < 1e-12);
+        REQUIRE(std::abs(params[i].mu - fit.params.mu) < 1e-12);
+    }
+}
+
+TEST_CASE("ARMA batch fit columns", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(2);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(0);
+
+    phi << 0.5, -0.2;
+
+    robarma::series_panel panel = robarma::simulate_panel(phi, theta, 0.0, 300, 10, 100, 7);
+    robarma::fit_columns columns = robarma::batch::fit_to_columns(panel, 2, 0, robarma::estimation_method::mm, {}, 2);
+    std::cout << columns.phi_matrix() << std::endl;
+
+    REQUIRE(columns.m == 10);
+    for (int i = 0; i < columns.m; i++)
+    {
+        REQUIRE(columns.convergence[i] == 1);
+        REQUIRE(columns.seconds[i] >= 0.0);
+        REQUIRE(std::abs(columns.params(i).phi(0) - 0.5) < 0.3);
+    }
+
+    // Round trip through the binary format
+    std::stringstream file;
+    columns.write(file);
+    robarma::fit_columns copy = robarma::fit_columns::read(file);
+    REQUIRE(copy.phi == columns.phi);
+    REQUIRE(copy.iterations == columns.iterations);
+
+    // An invalid shape is rejected before anything is allocated
+    REQUIRE_THROWS_AS(robarma::fit_columns(-1, 2, 0), std::invalid_argument);
+    REQUIRE_THROWS_AS(robarma::fit_columns(10, -2, 0), std::invalid_argument);
+}
+
+TEST_CASE("Metrics counters", "[metrics]")
+{
+    using robarma::estimation_method;
+
+    robarma::metrics::counters counters;
+    counters.solve({estimation_method::mm, false, 3, 10, 1, 100, 5e-6});
+    REQUIRE(counters.solves(estimation_method::mm) == 1);
+    REQUIRE(counters.failures(estimation_method::mm) == 1);
+    REQUIRE(counters.latency(estimation_method::mm)[2] == 1);
+
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    phi << 0.5;
+    Eigen::VectorXd y = robarma::simulate(phi, Eigen::VectorXd{}, 0.0, 300);
+    robarma::arma_model arma(y, 1, 0);
+
+    robarma::metrics::set_sink(&counters);
+    robarma::arma_fit fit = robarma::estimators::mm(arma);
+    robarma::metrics::set_sink(nullptr);
+
+    // Solves are reported only when compiled with ROBARMA_ENABLE_METRICS
+#ifdef ROBARMA_ENABLE_METRICS
+    REQUIRE(counters.solves(estimation_method::mm) == 2);
+    REQUIRE(counters.solves(estimation_method::s) == 1);
+#else
+    REQUIRE(counters.solves(estimation_method::mm) == 1);
+    REQUIRE(counters.solves(estimation_method::s) == 0);
+#endif
+}
+
+TEST_CASE("ARMA warm start", "[arma]")
+{
+    Eigen::VectorXd phi = Eigen::VectorXd::Zero(1);
+    Eigen::VectorXd theta = Eigen::VectorXd::Zero(1);
+
+    phi << 0.6;
+    theta << 0.3;
+
+    Eigen::VectorXd y = robarma::simulate(phi, theta, 0.0, 400);
+    robarma::arma_model arma(y, 1, 1);
+    robarma::arma_fit cold = robarma::estimators::mm(arma);
+
+    robarma::estimation_options options;
+    options.start.resize(3);
+    options.start << cold.params.phi, cold.params.theta, cold.params.mu;
+    robarma::arma_fit warm = robarma::estimators::mm(arma, options);
+    std::cout << cold.params.phi << " " << warm.params.phi << std::endl;
+
+    REQUIRE(warm.result.convergence);
+    REQUIRE(std::abs(warm.params.phi(0) - cold.params.phi(0)) < 1e-3);
+    REQUIRE(std::abs(warm.params.theta(0) - cold.params.theta(0)) < 1e-3);
+
+    // The warm start reaches the IRLS stage of MM and BIP-MM, not only the S-estimate
+    robarma::arma_fit initial = robarma::estimators::s(arma);
+    double sigma = initial.result.final_cost;
+    robarma::arma_fit cold_mm = robarma::mm::mm(arma, sigma, initial);
+    options.start << cold_mm.params.phi, cold_mm.params.theta, cold_mm.params.mu;
+    robarma::arma_fit warm_mm = robarma::mm::mm(arma, sigma, initial, options);
+    REQUIRE(warm_mm.result.convergence);
+    REQUIRE(warm_mm.result.iterations < cold_mm.result.iterations);
+    REQUIRE(warm_mm.result.evaluations < cold_mm.result.evaluations);
+
+    robarma::arma_fit cold_bmm = robarma::bmm::bmm(arma, sigma, initial);
+    options.start << cold_bmm.params.phi, cold_bmm.params.theta, cold_bmm.params.mu;
+    robarma::arma_fit warm_bmm = robarma::bmm::bmm(arma, sigma, initial, options);
+    REQUIRE(warm_bmm.result.convergence);
+    REQUIRE(warm_bmm.result.iterations < cold_bmm.result.iterations);
+
+    options.start.resize(2);
+    REQUIRE_THROWS_AS(robarma::estimators::mm(arma, options), std::invalid_argument);
+}
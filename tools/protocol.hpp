@@ -0,0 +1,337 @@
+/**
+ * @file protocol.hpp
+ * @brief Wire protocol between robarma_daemon and its clients.
+ *
+ * A client connects to the daemon's Unix domain socket and sends fixed-size requests, each
+ * answered by a response header followed by a payload of doubles and, on error, a message:
+ *
+ *  - fit: fit an ARMA(p, q) model to the n values of the series segment sent with the
+ *    request, warm-started from the cached fit of series_id when it has the same order and
+ *    method. Payload: phi, theta, mu.
+ *  - forecast: forecasts of the cached fit of series_id for horizons 1, ..., horizon with
+ *    prediction intervals at level. Payload: phi, theta, mu, then mean, lower and upper.
+ *  - filter: run the n new observations of the series segment through the cached filter of
+ *    series_id. Their one-step residuals overwrite the observations in the segment.
+ *    Payload: phi, theta, mu.
+ *
+ * Series travel in an anonymous memfd segment, created by the client and passed with the
+ * request as SCM_RIGHTS ancillary data, so the socket carries a few hundred bytes per
+ * request and no other process can name the segment. The client seals the segment against
+ * shrinking and growing before sending it, so the daemon's mapping stays valid whatever the
+ * client does with its descriptor. Both ends run on the same host, so all fields are in
+ * native byte order.
+ *
+ */
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+namespace robarma::daemon
+{
+    constexpr std::uint32_t magic = 0x524d4244;
+    constexpr std::uint32_t version = 2;
+
+    enum class command : std::uint32_t
+    {
+        fit = 1,
+        forecast = 2,
+        filter = 3
+    };
+
+    enum class status : std::uint32_t
+    {
+        ok = 0,
+        error = 1
+    };
+
+    struct request
+    {
+        std::uint32_t magic = daemon::magic;
+        std::uint32_t version = daemon::version;
+        command type = command::fit;
+        std::int32_t method = 0;
+        std::uint64_t series_id = 0;
+        std::int32_t p = 0;
+        std::int32_t q = 0;
+        std::int32_t horizon = 0;
+        double level = 0.95;
+        std::int64_t n = 0;
+    };
+
+    /**
+     * @brief Response header.
+     *
+     *  - warm: the fit was warm-started from the cache
+     *  - p, q: order of the parameters in the payload
+     *  - horizon: number of forecasts in the payload
+     *  - next: one-step forecast of the next observation
+     *  - message_length: bytes of the error message after the payload
+     */
+    struct response
+    {
+        status result = status::ok;
+        std::uint32_t warm = 0;
+        std::int32_t p = 0;
+        std::int32_t q = 0;
+        std::int32_t horizon = 0;
+        std::uint32_t convergence = 0;
+        std::int32_t iterations = 0;
+        std::uint32_t message_length = 0;
+        double cost = 0.0;
+        double seconds = 0.0;
+        double next = 0.0;
+    };
+
+    // Read exactly size bytes, false on end of stream, error or timeout
+    inline bool read_all(int fd, void *data, std::size_t size)
+    {
+        char *p = static_cast<char *>(data);
+        while (size > 0)
+        {
+            ssize_t got = ::read(fd, p, size);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got <= 0)
+                return false;
+            p += got;
+            size -= std::size_t(got);
+        }
+        return true;
+    }
+
+    inline bool write_all(int fd, const void *data, std::size_t size)
+    {
+        const char *p = static_cast<const char *>(data);
+        while (size > 0)
+        {
+            ssize_t put = ::write(fd, p, size);
+            if (put < 0 && errno == EINTR)
+                continue;
+            if (put <= 0)
+                return false;
+            p += put;
+            size -= std::size_t(put);
+        }
+        return true;
+    }
+
+    /**
+     * @brief Send a request with the descriptor of its series segment, if any.
+     *
+     * @param fd connected socket
+     * @param req
+     * @param series descriptor passed as SCM_RIGHTS with the first byte, -1 for none
+     * @return false if the connection failed
+     */
+    inline bool send_request(int fd, const request &req, int series)
+    {
+        const char *bytes = reinterpret_cast<const char *>(&req);
+        iovec data{const_cast<char *>(bytes), sizeof(req)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        if (series >= 0)
+        {
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            std::memcpy(CMSG_DATA(header), &series, sizeof(int));
+        }
+
+        ssize_t sent;
+        do
+            sent = ::sendmsg(fd, &message, MSG_NOSIGNAL);
+        while (sent < 0 && errno == EINTR);
+        if (sent <= 0)
+            return false;
+        return write_all(fd, bytes + sent, sizeof(req) - std::size_t(sent));
+    }
+
+    /**
+     * @brief Receive a request and the descriptor of its series segment.
+     *
+     * @param fd connected socket
+     * @param req
+     * @param series received descriptor, owned by the caller, or -1 if none was sent
+     * @return false on end of stream, error or timeout
+     */
+    inline bool receive_request(int fd, request &req, int &series)
+    {
+        series = -1;
+        char *bytes = reinterpret_cast<char *>(&req);
+        iovec data{bytes, sizeof(req)};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+
+        msghdr message{};
+        message.msg_iov = &data;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+
+        ssize_t got;
+        do
+            got = ::recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+        while (got < 0 && errno == EINTR);
+
+        for (cmsghdr *header = got > 0 ? CMSG_FIRSTHDR(&message) : nullptr; header; header = CMSG_NXTHDR(&message, header))
+            if (header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS)
+            {
+                std::size_t count = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                for (std::size_t i = 0; i < count; i++)
+                {
+                    int received;
+                    std::memcpy(&received, CMSG_DATA(header) + i * sizeof(int), sizeof(int));
+                    if (series < 0)
+                        series = received;
+                    else
+                        ::close(received);
+                }
+            }
+
+        // A truncated control message may have dropped descriptors; refuse the request
+        if (got <= 0 || (message.msg_flags & MSG_CTRUNC) || !read_all(fd, bytes + got, sizeof(req) - std::size_t(got)))
+        {
+            if (series >= 0)
+                ::close(series);
+            series = -1;
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Mapping of a sealed memfd segment holding n doubles.
+     */
+    class shared_series
+    {
+    public:
+        /**
+         * @brief Create a segment of n doubles, sealed against shrinking and growing.
+         *
+         * @param n number of doubles
+         */
+        explicit shared_series(std::int64_t n)
+            : n(n)
+        {
+            check_size(n);
+            fd = ::memfd_create("robarma-series", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+            if (fd < 0)
+                throw std::runtime_error("Cannot create series segment.");
+            try
+            {
+                if (::ftruncate(fd, off_t(bytes())) != 0 || ::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) != 0)
+                    throw std::runtime_error("Cannot size and seal series segment.");
+                map();
+            }
+            catch (...)
+            {
+                ::close(fd);
+                throw;
+            }
+        }
+
+        /**
+         * @brief Map a received segment, taking ownership of its descriptor.
+         *
+         * The segment must be sealed against shrinking, so that the mapping cannot be cut
+         * short by the sender, hold at least n doubles and be owned by the user uid.
+         *
+         * @param fd received descriptor
+         * @param n number of doubles
+         * @param uid user the segment must belong to
+         */
+        shared_series(int fd, std::int64_t n, uid_t uid)
+            : n(n), fd(fd)
+        {
+            try
+            {
+                check_size(n);
+                struct stat info;
+                int seals = ::fcntl(fd, F_GET_SEALS);
+                if (seals < 0 || !(seals & F_SEAL_SHRINK))
+                    throw std::invalid_argument("Series segment is not sealed against shrinking.");
+                if (::fstat(fd, &info) != 0 || info.st_uid != uid)
+                    throw std::invalid_argument("Series segment does not belong to the client.");
+                if (std::uint64_t(info.st_size) < bytes())
+                    throw std::invalid_argument("Series segment is smaller than " + std::to_string(n) + " values.");
+                map();
+            }
+            catch (...)
+            {
+                ::close(fd);
+                throw;
+            }
+        }
+
+        shared_series(const shared_series &) = delete;
+        shared_series &operator=(const shared_series &) = delete;
+
+        ~shared_series()
+        {
+            if (values)
+                ::munmap(values, bytes());
+            ::close(fd);
+        }
+
+        double *data() const
+        {
+            return values;
+        }
+
+        std::int64_t size() const
+        {
+            return n;
+        }
+
+        // Descriptor to pass with a request
+        int descriptor() const
+        {
+            return fd;
+        }
+
+    private:
+        std::int64_t n;
+        int fd = -1;
+        double *values = nullptr;
+
+        std::size_t bytes() const
+        {
+            return std::size_t(n) * sizeof(double);
+        }
+
+        static void check_size(std::int64_t n)
+        {
+            if (n < 0 || std::uint64_t(n) > std::uint64_t(std::numeric_limits<off_t>::max()) / sizeof(double))
+                throw std::invalid_argument("Invalid series segment size " + std::to_string(n) + ".");
+        }
+
+        void map()
+        {
+            if (n == 0)
+                return;
+            void *address = ::mmap(nullptr, bytes(), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (address == MAP_FAILED)
+                throw std::runtime_error("Cannot map series segment.");
+            values = static_cast<double *>(address);
+        }
+    };
+} // namespace robarma::daemon
+
+// end of file
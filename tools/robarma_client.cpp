@@ -0,0 +1,176 @@
+/**
+ * @file robarma_client.cpp
+ * @brief Command-line client of robarma_daemon.
+ *
+ *     robarma_client <socket path> fit <series id> <p> <q> [method] < values
+ *     robarma_client <socket path> forecast <series id> <horizon> [level]
+ *     robarma_client <socket path> filter <series id> < values
+ *
+ * Values are read from standard input, whitespace separated, and handed to the daemon in a
+ * sealed memfd segment sent with the request. Filter prints the one-step residual of every
+ * value.
+ *
+ */
+#include "protocol.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <estimation_result.hpp>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vector>
+
+namespace
+{
+    using namespace robarma::daemon;
+
+    int usage(const char *argv0)
+    {
+        std::cerr << "usage: " << argv0 << " <socket path> fit <series id> <p> <q> [method] < values\n"
+                  << "       " << argv0 << " <socket path> forecast <series id> <horizon> [level]\n"
+                  << "       " << argv0 << " <socket path> filter <series id> < values" << std::endl;
+        return 2;
+    }
+
+    std::string lower(std::string s)
+    {
+        std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c)
+                       { return char(std::tolower(c)); });
+        return s;
+    }
+
+    // Method index from its name as printed by to_string, case-insensitive
+    int parse_method(const std::string &name)
+    {
+        for (int i = 0; i < int(robarma::estimation_method::count); i++)
+            if (lower(robarma::to_string(static_cast<robarma::estimation_method>(i))) == lower(name))
+                return i;
+        throw std::invalid_argument("Unknown estimation method " + name + ".");
+    }
+
+    int connect_to(const std::string &path)
+    {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path))
+            throw std::invalid_argument("Socket path is too long: " + path);
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            if (fd >= 0)
+                ::close(fd);
+            throw std::runtime_error("Cannot connect to " + path + ".");
+        }
+        return fd;
+    }
+
+    void print(const char *label, const double *values, int n)
+    {
+        std::cout << label;
+        for (int i = 0; i < n; i++)
+            std::cout << " " << values[i];
+        std::cout << "\n";
+    }
+
+    int run(int argc, char **argv)
+    {
+        if (argc < 4)
+            return usage(argv[0]);
+
+        std::string action = argv[2];
+        request req;
+        req.series_id = std::stoull(argv[3]);
+
+        if (action == "fit" && (argc == 6 || argc == 7))
+        {
+            req.type = command::fit;
+            req.p = std::stoi(argv[4]);
+            req.q = std::stoi(argv[5]);
+            req.method = parse_method(argc == 7 ? argv[6] : "MM");
+        }
+        else if (action == "forecast" && (argc == 5 || argc == 6))
+        {
+            req.type = command::forecast;
+            req.horizon = std::stoi(argv[4]);
+            if (argc == 6)
+                req.level = std::stod(argv[5]);
+        }
+        else if (action == "filter" && argc == 4)
+            req.type = command::filter;
+        else
+            return usage(argv[0]);
+
+        // Hand the values over in a segment that lives until the reply has been read
+        std::vector<double> values;
+        if (req.type != command::forecast)
+        {
+            double y;
+            while (std::cin >> y)
+                values.push_back(y);
+        }
+        shared_series series(std::int64_t(values.size()));
+        std::copy(values.begin(), values.end(), series.data());
+        req.n = series.size();
+
+        int fd = connect_to(argv[1]);
+        response res;
+        bool sent = send_request(fd, req, req.type == command::forecast ? -1 : series.descriptor()) && read_all(fd, &res, sizeof(res));
+
+        std::vector<double> payload;
+        std::string message;
+        if (sent)
+        {
+            payload.resize(std::size_t(res.p) + res.q + (res.result == status::ok ? 1 : 0) + 3 * std::size_t(res.horizon));
+            message.resize(res.message_length);
+            sent = read_all(fd, payload.data(), payload.size() * sizeof(double)) && read_all(fd, &message[0], message.size());
+        }
+        ::close(fd);
+
+        if (!sent)
+            throw std::runtime_error("Connection to the daemon was closed.");
+        if (res.result != status::ok)
+        {
+            std::cerr << message << std::endl;
+            return 1;
+        }
+
+        const double *p = payload.data();
+        print("phi:", p, res.p);
+        print("theta:", p + res.p, res.q);
+        std::cout << "mu: " << p[res.p + res.q] << "\n";
+        if (req.type == command::fit)
+            std::cout << "cost: " << res.cost << "\nconvergence: " << res.convergence << "\niterations: " << res.iterations
+                      << "\nwarm: " << res.warm << "\nseconds: " << res.seconds << "\n";
+        if (req.type == command::forecast)
+        {
+            const double *forecasts = p + res.p + res.q + 1;
+            print("mean:", forecasts, res.horizon);
+            print("lower:", forecasts + res.horizon, res.horizon);
+            print("upper:", forecasts + 2 * res.horizon, res.horizon);
+        }
+        if (req.type == command::filter)
+            print("residuals:", series.data(), int(series.size()));
+        std::cout << "next: " << res.next << std::endl;
+        return 0;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    try
+    {
+        return run(argc, argv);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+}
+
+// end of file
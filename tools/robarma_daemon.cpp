@@ -0,0 +1,514 @@
+/**
+ * @file robarma_daemon.cpp
+ * @brief Local fitting daemon serving fit, forecast and filter requests over a Unix socket.
+ *
+ *     robarma_daemon <socket path> [--threads N] [--cache N]
+ *
+ * The main thread polls the listening socket and all idle connections; each request that
+ * arrives is handed to a pool of worker threads, sized like the batch engine's pool (all
+ * hardware threads by default), and the connection returns to the poll set once it has
+ * been answered. Idle clients therefore hold no worker. The socket is only accessible to
+ * the daemon's user, and connections of other users are refused.
+ *
+ * The fits of recently used series are kept in an LRU cache keyed by series ID, with their
+ * streaming filters: a new fit of a cached series starts from the cached parameters, and
+ * forecast and filter requests are answered from the cache without refitting. See
+ * protocol.hpp for the requests.
+ *
+ */
+#include "protocol.hpp"
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <atomic>
+#include <batch.hpp>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <estimators.hpp>
+#include <fcntl.h>
+#include <forecast.hpp>
+#include <iostream>
+#include <list>
+#include <logging.hpp>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <poll.h>
+#include <queue>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using namespace robarma::daemon;
+
+    std::atomic<bool> running{true};
+
+    // Longest wait for the rest of a started request, or for a client to take a reply
+    constexpr int io_timeout_seconds = 5;
+
+    void stop(int)
+    {
+        running = false;
+    }
+
+    struct entry
+    {
+        int p;
+        int q;
+        robarma::estimation_method method;
+        robarma::arma_filter filter;
+    };
+
+    // Cached entry with its own lock, so that requests on different series do not contend
+    struct slot
+    {
+        explicit slot(entry value)
+            : value(std::move(value))
+        {
+        }
+
+        std::mutex mutex;
+        entry value;
+    };
+
+    /**
+     * @brief LRU cache of fitted filters keyed by series ID.
+     *
+     * The cache lock only guards the index and the recency order; each entry is read and
+     * updated under the lock of its slot.
+     */
+    class fit_cache
+    {
+    public:
+        explicit fit_cache(std::size_t capacity)
+            : capacity(capacity)
+        {
+        }
+
+        std::shared_ptr<slot> get(std::uint64_t id)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(id);
+            if (it == index.end())
+                return nullptr;
+            order.splice(order.begin(), order, it->second);
+            return it->second->second;
+        }
+
+        void put(std::uint64_t id, entry value)
+        {
+            auto fresh = std::make_shared<slot>(std::move(value));
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(id);
+            if (it != index.end())
+                order.erase(it->second);
+            order.emplace_front(id, std::move(fresh));
+            index[id] = order.begin();
+
+            while (order.size() > capacity)
+            {
+                index.erase(order.back().first);
+                order.pop_back();
+            }
+        }
+
+    private:
+        std::size_t capacity;
+        std::mutex mutex;
+        std::list<std::pair<std::uint64_t, std::shared_ptr<slot>>> order;
+        std::unordered_map<std::uint64_t, std::list<std::pair<std::uint64_t, std::shared_ptr<slot>>>::iterator> index;
+    };
+
+    // Copy of the cached entry of id, taken under its slot lock
+    std::optional<entry> snapshot(fit_cache &cache, std::uint64_t id)
+    {
+        std::shared_ptr<slot> cached = cache.get(id);
+        if (!cached)
+            return std::nullopt;
+        std::lock_guard<std::mutex> lock(cached->mutex);
+        return cached->value;
+    }
+
+    struct reply
+    {
+        response header;
+        std::vector<double> payload;
+        std::string message;
+    };
+
+    // A connection with the user of its peer
+    struct client
+    {
+        int fd;
+        uid_t uid;
+    };
+
+    void put_params(reply &out, const robarma::arma_params &params)
+    {
+        out.header.p = int(params.phi.size());
+        out.header.q = int(params.theta.size());
+        out.payload.insert(out.payload.end(), params.phi.data(), params.phi.data() + params.phi.size());
+        out.payload.insert(out.payload.end(), params.theta.data(), params.theta.data() + params.theta.size());
+        out.payload.push_back(params.mu);
+    }
+
+    // Shortest series the Hannan-Rissanen start can be computed for
+    std::int64_t min_length(int p, int q)
+    {
+        return 3 * std::int64_t(std::max(p, q)) + 2 + p + q;
+    }
+
+    // Take over the descriptor of the segment sent with a request
+    int take(const request &req, int &series)
+    {
+        if (series < 0)
+            throw std::invalid_argument("Request of " + std::to_string(req.n) + " values came without a series segment.");
+        int fd = series;
+        series = -1;
+        return fd;
+    }
+
+    reply fit(const request &req, int &series, const client &from, fit_cache &cache)
+    {
+        if (req.method < 0 || req.method >= int(robarma::estimation_method::count))
+            throw std::invalid_argument("Unknown estimation method " + std::to_string(req.method) + ".");
+        if (req.p < 0 || req.q < 0 || req.n < min_length(req.p, req.q) || req.n > INT_MAX)
+            throw std::invalid_argument("Series of length " + std::to_string(req.n) + " cannot be fitted with an ARMA(" + std::to_string(req.p) + ", " + std::to_string(req.q) + ") model.");
+
+        auto start = std::chrono::steady_clock::now();
+        auto method = static_cast<robarma::estimation_method>(req.method);
+
+        shared_series values(take(req, series), req.n, from.uid);
+        robarma::arma_model model = robarma::arma_model::view(Eigen::Map<const Eigen::VectorXd>(values.data(), req.n), req.p, req.q);
+
+        // Warm start from the cached fit of the same model
+        robarma::estimation_options options;
+        std::optional<entry> cached = snapshot(cache, req.series_id);
+        bool warm = cached && cached->p == req.p && cached->q == req.q && cached->method == method;
+        if (warm)
+        {
+            const robarma::arma_params &params = cached->filter.params;
+            options.start.resize(req.p + req.q + 1);
+            options.start << params.phi, params.theta, params.mu;
+        }
+
+        robarma::arma_fit result = robarma::estimators::fit(model, method, options);
+        robarma::arma_filter filter(result);
+
+        reply out;
+        out.header.warm = warm;
+        out.header.convergence = result.result.convergence;
+        out.header.iterations = result.result.iterations;
+        out.header.cost = result.result.final_cost;
+        out.header.next = filter.predict();
+        put_params(out, result.params);
+
+        cache.put(req.series_id, entry{req.p, req.q, method, filter});
+        out.header.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return out;
+    }
+
+    reply forecast(const request &req, fit_cache &cache)
+    {
+        std::optional<entry> cached = snapshot(cache, req.series_id);
+        if (!cached)
+            throw std::invalid_argument("Series " + std::to_string(req.series_id) + " is not cached; fit it first.");
+
+        const robarma::arma_filter &filter = cached->filter;
+        robarma::forecast_result result = filter.forecast(req.horizon, req.level);
+
+        reply out;
+        out.header.horizon = req.horizon;
+        out.header.next = filter.predict();
+        put_params(out, filter.params);
+        out.payload.insert(out.payload.end(), result.mean.data(), result.mean.data() + req.horizon);
+        out.payload.insert(out.payload.end(), result.lower.data(), result.lower.data() + req.horizon);
+        out.payload.insert(out.payload.end(), result.upper.data(), result.upper.data() + req.horizon);
+        return out;
+    }
+
+    reply filter(const request &req, int &series, const client &from, fit_cache &cache)
+    {
+        std::optional<shared_series> values;
+        if (req.n != 0)
+            values.emplace(take(req, series), req.n, from.uid);
+        std::shared_ptr<slot> cached = cache.get(req.series_id);
+        if (!cached)
+            throw std::invalid_argument("Series " + std::to_string(req.series_id) + " is not cached; fit it first.");
+
+        // Filters of the same series are serialized by the slot lock, so no update is lost;
+        // the copy is only stored back once all values have gone through it
+        std::lock_guard<std::mutex> lock(cached->mutex);
+        robarma::arma_filter filter = cached->value.filter;
+        double *data = values ? values->data() : nullptr;
+        for (std::int64_t t = 0; t < req.n; t++)
+            data[t] = filter.update(data[t]);
+        cached->value.filter = filter;
+
+        reply out;
+        out.header.next = filter.predict();
+        put_params(out, filter.params);
+        return out;
+    }
+
+    reply handle(const request &req, int &series, const client &from, fit_cache &cache)
+    {
+        try
+        {
+            if (req.magic != magic || req.version != version)
+                throw std::invalid_argument("Unsupported protocol version.");
+            switch (req.type)
+            {
+            case command::fit:
+                return fit(req, series, from, cache);
+            case command::forecast:
+                return forecast(req, cache);
+            case command::filter:
+                return filter(req, series, from, cache);
+            }
+            throw std::invalid_argument("Unknown request type.");
+        }
+        catch (const std::exception &e)
+        {
+            reply out;
+            out.header.result = status::error;
+            out.message = e.what();
+            out.header.message_length = std::uint32_t(out.message.size());
+            return out;
+        }
+    }
+
+    // Serve one request of a readable connection, false if the connection is done
+    bool serve(const client &from, fit_cache &cache)
+    {
+        request req;
+        int series;
+        if (!receive_request(from.fd, req, series))
+            return false;
+
+        reply out = handle(req, series, from, cache);
+        if (series >= 0)
+            ::close(series);
+        return write_all(from.fd, &out.header, sizeof(out.header)) &&
+               write_all(from.fd, out.payload.data(), out.payload.size() * sizeof(double)) &&
+               write_all(from.fd, out.message.data(), out.message.size());
+    }
+
+    // Peer of a new connection if it runs as the daemon's user, with bounded reads and writes
+    std::optional<client> admit(int fd)
+    {
+        ucred peer{};
+        socklen_t length = sizeof(peer);
+        if (::getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) != 0 || peer.uid != ::geteuid())
+            return std::nullopt;
+
+        timeval timeout{io_timeout_seconds, 0};
+        if (::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) != 0 ||
+            ::setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) != 0)
+            return std::nullopt;
+        return client{fd, peer.uid};
+    }
+
+    int listen_on(const std::string &path)
+    {
+        sockaddr_un address{};
+        if (path.size() >= sizeof(address.sun_path))
+            throw std::invalid_argument("Socket path is too long: " + path);
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, path.c_str(), sizeof(address.sun_path) - 1);
+
+        int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+            throw std::runtime_error("Cannot create socket.");
+        ::unlink(path.c_str());
+
+        // Restrict the socket to the daemon's user before it accepts connections
+        if (::bind(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+            ::chmod(path.c_str(), S_IRUSR | S_IWUSR) != 0 || ::listen(fd, 64) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Cannot listen on " + path + ".");
+        }
+        return fd;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <socket path> [--threads N] [--cache N]" << std::endl;
+        return 2;
+    }
+
+    std::string path = argv[1];
+    int threads = 0;
+    std::size_t capacity = 1024;
+    for (int i = 2; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        if (flag == "--threads")
+            threads = std::atoi(argv[i + 1]);
+        else if (flag == "--cache")
+            capacity = std::size_t(std::max(1, std::atoi(argv[i + 1])));
+        else
+        {
+            std::cerr << "unknown option " << flag << std::endl;
+            return 2;
+        }
+    }
+
+    std::signal(SIGINT, stop);
+    std::signal(SIGTERM, stop);
+    std::signal(SIGPIPE, SIG_IGN);
+    robarma::disable_ceres_logging(argv[0]);
+
+    int listener;
+    int wake[2];
+    try
+    {
+        listener = listen_on(path);
+        if (::pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0)
+            throw std::runtime_error("Cannot create wake-up pipe.");
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    // Readable connections wait in requests for a worker, which hands them back in done
+    // together with whether they stay open. Only the main thread closes connections.
+    fit_cache cache(capacity);
+    std::mutex queue_mutex;
+    std::condition_variable ready;
+    std::queue<client> requests;
+    std::vector<std::pair<client, bool>> done;
+
+    std::vector<std::thread> pool;
+    int n_workers = robarma::batch::workers(threads, INT_MAX);
+    for (int w = 0; w < n_workers; w++)
+        pool.emplace_back([&]()
+                          {
+            while (true)
+            {
+                client from;
+                {
+                    std::unique_lock<std::mutex> lock(queue_mutex);
+                    ready.wait(lock, [&]()
+                               { return !requests.empty() || !running; });
+                    if (!running)
+                        return;
+                    from = requests.front();
+                    requests.pop();
+                }
+                bool open = serve(from, cache);
+                {
+                    std::lock_guard<std::mutex> lock(queue_mutex);
+                    done.emplace_back(from, open);
+                }
+                char byte = 0;
+                (void)!::write(wake[1], &byte, 1);
+            } });
+
+    std::cerr << "robarma_daemon listening on " << path << " with " << n_workers << " workers" << std::endl;
+
+    // Connections owned by the main thread, waiting for their next request
+    std::vector<client> idle;
+    std::vector<int> open;
+    auto close_client = [&](int fd)
+    {
+        open.erase(std::find(open.begin(), open.end(), fd));
+        ::close(fd);
+    };
+
+    // Poll with a timeout so that a signal stops the loop
+    while (running)
+    {
+        std::vector<pollfd> waiting{{wake[0], POLLIN, 0}, {listener, POLLIN, 0}};
+        for (const client &c : idle)
+            waiting.push_back({c.fd, POLLIN, 0});
+        if (::poll(waiting.data(), waiting.size(), 200) <= 0)
+            continue;
+
+        std::vector<client> still_idle;
+        int dispatched = 0;
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            for (std::size_t i = 0; i < idle.size(); i++)
+            {
+                if (waiting[i + 2].revents)
+                {
+                    requests.push(idle[i]);
+                    dispatched++;
+                }
+                else
+                    still_idle.push_back(idle[i]);
+            }
+        }
+        for (int i = 0; i < dispatched; i++)
+            ready.notify_one();
+
+        if (waiting[0].revents)
+        {
+            char drain[64];
+            while (::read(wake[0], drain, sizeof(drain)) > 0)
+            {
+            }
+            std::vector<std::pair<client, bool>> finished;
+            {
+                std::lock_guard<std::mutex> lock(queue_mutex);
+                finished.swap(done);
+            }
+            for (const auto &[c, keep] : finished)
+            {
+                if (keep)
+                    still_idle.push_back(c);
+                else
+                    close_client(c.fd);
+            }
+        }
+
+        if (waiting[1].revents)
+        {
+            int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0)
+            {
+                open.push_back(fd);
+                if (std::optional<client> c = admit(fd))
+                    still_idle.push_back(*c);
+                else
+                    close_client(fd);
+            }
+        }
+        idle.swap(still_idle);
+    }
+
+    // Wake workers blocked on a connection, let them finish, then close everything
+    for (int fd : open)
+        ::shutdown(fd, SHUT_RDWR);
+    ready.notify_all();
+    for (std::thread &worker : pool)
+        worker.join();
+    for (int fd : open)
+        ::close(fd);
+    ::close(wake[0]);
+    ::close(wake[1]);
+    ::close(listener);
+    ::unlink(path.c_str());
+    return 0;
+}
+
+// end of file